@@ -1,5 +1,8 @@
 #include "../noclip.h"
 
+#include <thread>
+#include <chrono>
+
 void printstuff()
 {
     std::cout << "pog" << std::endl;
@@ -47,9 +50,25 @@ int main()
     c.bind_cvar("ax", &a.x);
     c.bind_cmd("af", &A::f, &a);
 
+    /*  Read stdin on a background thread so the main loop never blocks on
+        the terminal. Complete lines are handed over through the console's
+        queue and executed when the main loop pumps it. */
+    std::thread stdin_reader([&c]()
+        {
+            std::string line;
+            while(std::getline(std::cin, line))
+            {
+                c.enqueue(line);
+            }
+        });
+    stdin_reader.detach();
+
     while(true)
     {
-        c.execute(std::cin, std::cout);
+        c.pump(std::cout);
+
+        /* ... tick the rest of the program ... */
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
     }
 
     return 0;
@@ -0,0 +1,253 @@
+/*
+    Raw-mode terminal frontend for noclip::console (POSIX only).
+
+    Supports history (up/down), tab completion, cursor movement (left/right,
+    home/end, ctrl-a/ctrl-e), backspace and delete. Instead of redrawing
+    the whole line on every keystroke, each burst of input is applied to
+    the line state and then a single write sends the minimal escape
+    sequences that turn the previous line into the new one. This keeps the
+    console responsive over slow links (e.g. SSH), where escape sequences
+    may also arrive split across several reads.
+
+    Build: g++ -std=c++11 line_editor.cpp -o line_editor
+*/
+#include "../noclip.h"
+
+#include <termios.h>
+#include <unistd.h>
+
+struct line_state
+{
+    std::string text;
+    size_t cursor = 0;
+};
+
+static termios original_termios;
+
+static void enable_raw_mode()
+{
+    tcgetattr(STDIN_FILENO, &original_termios);
+    termios raw = original_termios;
+    raw.c_iflag &= ~(ICRNL | IXON);
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+}
+
+static void disable_raw_mode()
+{
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &original_termios);
+}
+
+static void move_cursor(std::string& out, size_t from, size_t to)
+{
+    if(from == to) return;
+    out += "\x1b[";
+    out += std::to_string(from > to ? from - to : to - from);
+    out += (from > to) ? 'D' : 'C';
+}
+
+static void diff_redraw(const line_state& prev, const line_state& next, std::string& out)
+{
+    /*  Only the part of the line after the common prefix is rewritten. The
+        terminal cursor is assumed to sit at prev.cursor. */
+    size_t common = 0;
+    while(common < prev.text.size() && common < next.text.size()
+        && prev.text[common] == next.text[common])
+    {
+        ++common;
+    }
+
+    if(common == prev.text.size() && common == next.text.size())
+    {
+        move_cursor(out, prev.cursor, next.cursor);
+        return;
+    }
+
+    move_cursor(out, prev.cursor, common);
+    out.append(next.text, common, std::string::npos);
+    if(next.text.size() < prev.text.size())
+    {
+        out += "\x1b[K"; // clear leftovers of the longer previous line
+    }
+    move_cursor(out, next.text.size(), next.cursor);
+}
+
+static bool escape_complete(const std::string& seq)
+{
+    /*  seq starts with ESC. CSI sequences (ESC [ ...) end with a byte in
+        0x40-0x7E, SS3 sequences (ESC O x) are always three bytes. */
+    if(seq.size() < 3) return false;
+    if(seq[1] == 'O') return true;
+    unsigned char last = seq.back();
+    return last >= 0x40 && last <= 0x7E;
+}
+
+static void full_redraw(const char* prompt, const line_state& line, std::string& out)
+{
+    out += "\r\x1b[K";
+    out += prompt;
+    out += line.text;
+    move_cursor(out, line.text.size(), line.cursor);
+}
+
+int main()
+{
+    noclip::console c;
+
+    int health = 100;
+    float gravity = 9.8f;
+    std::string name = "player";
+    c.bind_cvar("health", &health);
+    c.bind_cvar("gravity", &gravity);
+    c.bind_cvar("name", &name);
+
+    bool running = true;
+    c.bind_cmd("quit", [&running](std::istream& is, std::ostream& os){ running = false; });
+
+    const char* prompt = "] ";
+    line_state line;
+    size_t history_index = 0;
+    std::vector<const std::string*> matches;
+    std::string escape; // partial escape sequence, kept across reads
+
+    enable_raw_mode();
+
+    std::string out = prompt;
+    write(STDOUT_FILENO, out.data(), out.size());
+
+    while(running)
+    {
+        char burst[64];
+        ssize_t n = read(STDIN_FILENO, burst, sizeof(burst));
+        if(n <= 0) break;
+
+        line_state before = line;
+        out.clear();
+
+        for (ssize_t i = 0; i < n && running; ++i)
+        {
+            char ch = burst[i];
+
+            if(!escape.empty())
+            {
+                if(escape.size() == 1 && ch != '[' && ch != 'O')
+                {
+                    escape.clear(); // lone ESC, ch is handled as a normal key
+                }
+                else
+                {
+                    escape += ch;
+                    if(!escape_complete(escape)) continue;
+
+                    /*  e.g. ESC [ A, ESC O H, ESC [ 3 ~ */
+                    char code = escape.back();
+                    std::string params = escape.substr(2, escape.size() - 3);
+                    escape.clear();
+
+                    if(code == '~')
+                    {
+                        if(params == "1" || params == "7") code = 'H';
+                        else if(params == "4" || params == "8") code = 'F';
+                        else if(params == "3") code = 'x'; // delete
+                    }
+
+                    if(code == 'D' && line.cursor > 0) --line.cursor;
+                    else if(code == 'C' && line.cursor < line.text.size()) ++line.cursor;
+                    else if(code == 'H') line.cursor = 0;
+                    else if(code == 'F') line.cursor = line.text.size();
+                    else if(code == 'x' && line.cursor < line.text.size()) line.text.erase(line.cursor, 1);
+                    else if((code == 'A' || code == 'B') && !c.history.empty())
+                    {
+                        if(code == 'A' && history_index > 0) --history_index;
+                        if(code == 'B' && history_index < c.history.size()) ++history_index;
+
+                        line.text = history_index < c.history.size() ? c.history[history_index] : std::string();
+                        line.cursor = line.text.size();
+                    }
+                    continue;
+                }
+            }
+
+            if(ch == '\r' || ch == '\n')
+            {
+                /* Flush pending edits, then run the command below the line. */
+                diff_redraw(before, line, out);
+                out += "\r\n";
+
+                std::ostringstream result;
+                c.add_history(line.text);
+                c.execute(line.text, result);
+                out += result.str();
+                out += prompt;
+
+                line = line_state();
+                before = line;
+                history_index = c.history.size();
+            }
+            else if(ch == 3 || ch == 4) // ctrl-c, ctrl-d
+            {
+                running = false;
+            }
+            else if(ch == 127 || ch == 8) // backspace
+            {
+                if(line.cursor > 0)
+                {
+                    line.text.erase(--line.cursor, 1);
+                }
+            }
+            else if(ch == 1) // ctrl-a
+            {
+                line.cursor = 0;
+            }
+            else if(ch == 5) // ctrl-e
+            {
+                line.cursor = line.text.size();
+            }
+            else if(ch == '\t')
+            {
+                c.complete(line.text.substr(0, line.cursor), matches);
+                size_t word_start = line.text.find_last_of(" \t", line.cursor ? line.cursor - 1 : 0);
+                word_start = (word_start == std::string::npos || line.cursor == 0) ? 0 : word_start + 1;
+
+                if(matches.size() == 1)
+                {
+                    line.text.replace(word_start, line.cursor - word_start, *matches[0] + " ");
+                    line.cursor = word_start + matches[0]->size() + 1;
+                }
+                else if(matches.size() > 1)
+                {
+                    diff_redraw(before, line, out);
+                    out += "\r\n";
+                    for (auto match : matches)
+                    {
+                        out += *match;
+                        out += "  ";
+                    }
+                    out += "\r\n";
+                    full_redraw(prompt, line, out);
+                    before = line;
+                }
+            }
+            else if(ch == '\x1b')
+            {
+                escape = ch;
+            }
+            else if(ch >= 32 && ch < 127)
+            {
+                line.text.insert(line.cursor++, 1, ch);
+            }
+        }
+
+        diff_redraw(before, line, out);
+
+        if(!out.empty())
+        {
+            write(STDOUT_FILENO, out.data(), out.size());
+        }
+    }
+
+    disable_raw_mode();
+    write(STDOUT_FILENO, "\r\n", 2);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+    Soak / load test for noclip::console.
+
+    Builds a console with a configurable number of CVars and commands, then
+    drives it from N producer threads through the console's command queue
+    while the main thread pumps it, the way a server would. Every second it
+    reports throughput and p50/p99/p999 latency (from enqueue until the
+    command finished executing), followed by a summary for the whole run.
+
+    Usage: load_test [producers=4] [seconds=10] [cvars=1000] [cmds=1000]
+                     [window=64] [mix=40,30,20,10]
+
+    mix is the percentage of set, get, nested expression and script
+    (a batch of 8 sets) operations. window is how many operations each
+    producer keeps in flight.
+
+    Build: g++ -std=c++11 -O2 -pthread load_test.cpp -o load_test
+*/
+#include "../noclip.h"
+
+#include <thread>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+
+typedef std::chrono::steady_clock clock_type;
+
+static long long now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+}
+
+static int arg_int(int argc, char** argv, const std::string& key, int fallback)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg.compare(0, key.size() + 1, key + "=") == 0) return std::atoi(arg.c_str() + key.size() + 1);
+    }
+    return fallback;
+}
+
+static std::string arg_str(int argc, char** argv, const std::string& key, const std::string& fallback)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if(arg.compare(0, key.size() + 1, key + "=") == 0) return arg.substr(key.size() + 1);
+    }
+    return fallback;
+}
+
+static double percentile(std::vector<double>& sorted, double p)
+{
+    if(sorted.empty()) return 0.0;
+    size_t i = (size_t)(p * (sorted.size() - 1));
+    return sorted[i];
+}
+
+static void report(const char* label, std::vector<double>& latencies_us, double seconds)
+{
+    std::sort(latencies_us.begin(), latencies_us.end());
+    std::printf("%-8s %10.0f op/s   p50 %8.1f us   p99 %8.1f us   p999 %8.1f us\n", label,
+        latencies_us.size() / seconds,
+        percentile(latencies_us, 0.5), percentile(latencies_us, 0.99), percentile(latencies_us, 0.999));
+}
+
+int main(int argc, char** argv)
+{
+    const int producers = arg_int(argc, argv, "producers", 4);
+    const int seconds = arg_int(argc, argv, "seconds", 10);
+    const int cvar_count = std::max(1, arg_int(argc, argv, "cvars", 1000));
+    const int cmd_count = std::max(1, arg_int(argc, argv, "cmds", 1000));
+    const int window = std::max(1, arg_int(argc, argv, "window", 64));
+
+    int mix[4] = { 40, 30, 20, 10 };
+    std::istringstream mix_stream(arg_str(argc, argv, "mix", "40,30,20,10"));
+    for (int i = 0; i < 4 && mix_stream >> mix[i]; ++i)
+    {
+        mix_stream.ignore(); // ','
+    }
+
+    noclip::console c;
+
+    std::vector<int> cvars(cvar_count);
+    for (int i = 0; i < cvar_count; ++i)
+    {
+        c.bind_cvar("cvar_" + std::to_string(i), &cvars[i]);
+    }
+
+    volatile long long sink = 0;
+    for (int i = 0; i < cmd_count; ++i)
+    {
+        c.bind_cmd("cmd_" + std::to_string(i), [&sink](std::istream& is, std::ostream& os)
+            {
+                int x = 0;
+                is >> x;
+                sink = sink + x;
+            });
+    }
+
+    /*  Every queued operation ends with 'lt_done <producer> <enqueue time>',
+        which records its latency and returns its slot in the window. */
+    std::unique_ptr<std::atomic<int>[]> in_flight(new std::atomic<int>[producers]);
+    for (int i = 0; i < producers; ++i)
+    {
+        in_flight[i] = 0;
+    }
+
+    std::vector<double> interval_us;
+    std::vector<double> total_us;
+    c.bind_cmd("lt_done", [&](std::istream& is, std::ostream& os)
+        {
+            int producer = 0;
+            long long enqueued = 0;
+            is >> producer >> enqueued;
+            double us = (now_ns() - enqueued) / 1000.0;
+            interval_us.push_back(us);
+            total_us.push_back(us);
+            in_flight[producer].fetch_sub(1, std::memory_order_release);
+        });
+
+    std::atomic<bool> running(true);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]()
+            {
+                std::mt19937 rng(p + 1);
+                std::string op;
+                while(running.load(std::memory_order_relaxed))
+                {
+                    if(in_flight[p].load(std::memory_order_acquire) >= window)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    int roll = (int)(rng() % 100);
+                    std::string a = std::to_string(rng() % cvar_count);
+                    std::string b = std::to_string(rng() % cvar_count);
+
+                    op.clear();
+                    if((roll -= mix[0]) < 0)
+                    {
+                        op = "set cvar_" + a + " " + std::to_string(rng() % 1000);
+                    }
+                    else if((roll -= mix[1]) < 0)
+                    {
+                        op = "get cvar_" + a;
+                    }
+                    else if((roll -= mix[2]) < 0)
+                    {
+                        op = "set cvar_" + a + " (+ (get cvar_" + b + ") (* 2 (% " + a + " 7)))";
+                    }
+                    else if((roll -= mix[3]) < 0)
+                    {
+                        for (int i = 0; i < 8; ++i)
+                        {
+                            op += "set cvar_" + std::to_string(rng() % cvar_count) + " " + std::to_string(i) + "\n";
+                        }
+                        op += "cmd_" + std::to_string(rng() % cmd_count) + " 1";
+                    }
+                    else
+                    {
+                        op = "cmd_" + std::to_string(rng() % cmd_count) + " 1";
+                    }
+
+                    op += "\nlt_done " + std::to_string(p) + " " + std::to_string(now_ns());
+                    in_flight[p].fetch_add(1, std::memory_order_relaxed);
+                    c.enqueue(op);
+                }
+            });
+    }
+
+    std::printf("producers=%d cvars=%d cmds=%d window=%d mix=set %d, get %d, expr %d, script %d\n",
+        producers, cvar_count, cmd_count, window, mix[0], mix[1], mix[2], mix[3]);
+
+    std::ostringstream discard;
+    clock_type::time_point start = clock_type::now();
+    clock_type::time_point interval_start = start;
+    int interval = 0;
+    while(interval < seconds)
+    {
+        c.pump(discard);
+        discard.str("");
+
+        clock_type::time_point now = clock_type::now();
+        if(now - interval_start >= std::chrono::seconds(1))
+        {
+            char label[16];
+            std::snprintf(label, sizeof(label), "t=%ds", ++interval);
+            report(label, interval_us, std::chrono::duration<double>(now - interval_start).count());
+            interval_us.clear();
+            interval_start = now;
+        }
+    }
+
+    running = false;
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    c.pump(discard);
+
+    report("total", total_us, std::chrono::duration<double>(clock_type::now() - start).count());
+
+    return 0;
+}
@@ -35,20 +35,69 @@ be able to change variables or call certain functions based on text input,
 noclip::console will be useful.
 
 QUICK INTERFACE:
-    function    | example
-    ------------|-----------------------------------------
-    bind_cvar   | console.bind_cvar("health", &health);
-                |
-    bind_cmd    | console.bind_cmd("command", someFunction);
-                | console.bind_cmd("command", &Object::memberFunc, &objectInstance);
-                | console.bind_cmd("command", [](std::istream& is, std::ostream& os){ lambda body });
-                |
-    unbind_cvar | console.unbind_cvar("health"); // useful if 'health' goes out of scope (i.e. dealloc'ed)
-                |
-    unbind_cmd  | console.unbind_cvar("command"); // useful if object owning 'command' goes out of scope
-                |
-    execute     | console.execute(std::cin, std::cout);
-                | console.execute("set health 99", std::cout);
+    function            | example
+    --------------------|-----------------------------------------
+    bind_cvar           | console.bind_cvar("health", &health);
+                        | console.bind_cvar("frame_ms", &frame_ms); // noclip::hot<float>, on its own cache line
+                        | console.bind_cvar("net_packets_in", &packets_in); // noclip::counter, packets_in.add() from any thread
+                        | console.bind_cvar("gravity", &gravity); // noclip::latched<float>, 'set' takes effect on console.latch()
+                        |
+    keep_pending_values | console.keep_pending_values = true; // 'set' before bind_cvar is applied on bind
+                        |
+    bind_flag           | auto id = console.bind_flag("r_debug_bounds", "debug_draw"); // packed bool, in group debug_draw
+                        | console.test_flag(id); console.set_flags("debug_draw", noclip::console::flag_clear);
+                        |
+    bind_computed_cvar  | console.bind_computed_cvar("entity_count", [&]{ return world.count(); }, 0.5); // read-only, cached for 0.5s
+                        |
+    set_cvar_policy     | console.set_cvar_policy("r_exposure", noclip::console::set_debounce, 0.1); // or set_coalesce
+                        |
+    define_preset       | console.define_preset("low", "set r_shadows 0\nset r_lod_bias 2.5\n", std::cout); // 'preset low'
+                        |
+    bind_cmd            | console.bind_cmd("command", someFunction);
+                        | console.bind_cmd("command", &Object::memberFunc, &objectInstance);
+                        | console.bind_cmd("command", [](std::istream& is, std::ostream& os){ lambda body });
+                        |
+    bind_many           | noclip::console::registration_batch batch(console); batch.reserve(10000, 0);
+                        | batch.cvar("health", &health); batch.cmd("spawn", spawn); console.bind_many(batch);
+                        |
+    bind_generator      | console.bind_generator("dumpEntities", [&](std::istream& is, std::ostream& os){ return world.dumper(); });
+                        | auto gen = console.open("listCVars", errors); while(gen && gen(client_stream)) wait_for_client();
+                        |
+    unbind_cvar         | console.unbind_cvar("health"); // useful if 'health' goes out of scope (i.e. dealloc'ed)
+                        |
+    unbind_cmd          | console.unbind_cvar("command"); // useful if object owning 'command' goes out of scope
+                        |
+    execute             | console.execute(std::cin, std::cout);
+                        | console.execute("set health 99", std::cout);
+                        |
+    no_alloc_scope      | { noclip::no_alloc_scope guard; console.execute(line_stream, out); } // see NOCLIP_CHECK_ALLOCATIONS
+                        |
+    execute_batch       | console.execute_batch("set health 99\nset armor 50", std::cout); // one command per line
+                        |
+    enqueue             | console.enqueue(line); // thread-safe, e.g. from a stdin reader thread
+                        |
+    pump                | console.pump(std::cout); // once per tick, executes queued commands
+                        | console.pump(channel); // noclip::command_channel, e.g. in shared memory with a tool
+                        |
+    complete            | console.complete("set hea", matches); // matches -> { "health" }
+                        |
+    bind_completion     | console.bind_completion("map", maps.provider()); // maps is a noclip::path_index
+                        | maps.rebuild([](std::vector<std::string>& paths){ ... }); // lists files in the background
+                        |
+    find_cvar           | noclip::console::cvar_id_t ids[] = { console.find_cvar("fov"), console.find_cvar("name") };
+                        |
+    read_many           | console.read_many(ids, settings.fov, settings.name); // typed gather, one pass
+                        |
+    write_many          | console.write_many(ids, 90.f, std::string("kevin")); // one change notification
+                        |
+    suggest             | console.suggest("helth", console.cvar_getter_lambdas); // -> "health", or nullptr
+                        |
+    load_help_file      | console.load_help_file("help.txt"); // entries of '@<id>' + text, read lazily by 'help <id>'
+                        |
+    add_history         | console.add_history(line); // console.history holds submitted lines, oldest first
+                        |
+    add_log_channel     | auto& render_log = console.add_log_channel("render"); // level in CVar 'log_render'
+                        | NOCLIP_LOG(render_log, noclip::console::log_info, "loaded " << n << " meshes");
 
 CREATING A CONSOLE:
     noclip::console console;
@@ -107,37 +156,2045 @@ to give the stored behaviour an input to read from.
 
 #include <iostream>
 #include <sstream>
+#include <fstream>
+#include <iomanip>
 #include <functional>
 #include <map>
+#include <unordered_map>
+#include <set>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <type_traits>
+#include <string>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <typeinfo>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+/*  Messages above this level are compiled out of NOCLIP_LOG entirely. */
+#ifndef NOCLIP_LOG_MAX_LEVEL
+#define NOCLIP_LOG_MAX_LEVEL 4
+#endif
+
+/*  NOCLIP_LOG(render_log, noclip::console::log_info, "loaded " << n << " meshes");
+    The message is only formatted if the channel's level lets it through. */
+#define NOCLIP_LOG(channel, level, message) \
+    do \
+    { \
+        if((level) <= NOCLIP_LOG_MAX_LEVEL && (channel).enabled(level)) \
+        { \
+            std::ostringstream noclip_log_stream; \
+            noclip_log_stream << message; \
+            (channel).write(level, noclip_log_stream.str()); \
+        } \
+    } while(0)
 
 namespace noclip
 {
     typedef std::function<void(std::istream& is, std::ostream& os)> console_function_t;
 
+    /*  Completes argument arg_index (0 is the first argument) of a command.
+        Appends pointers to matching strings owned by the provider, which
+        must stay valid until the provider is called again. */
+    typedef std::function<void(size_t arg_index, const std::string& prefix,
+        std::vector<const std::string*>& out)> completion_provider_t;
+
+    /*  Streams a command's output in chunks: each call writes the next chunk
+        and returns whether there is more. A generator_factory_t parses the
+        command's arguments (reporting errors to os) and returns the
+        generator, or an empty one if there is nothing to produce. */
+    typedef std::function<bool(std::ostream& os)> generator_t;
+    typedef std::function<generator_t(std::istream& is, std::ostream& os)> generator_factory_t;
+
+    struct name_pool
+    {
+        /*  Ids grouped by length for suggest. All ids in a group have the same
+            length, so each group is one contiguous char array with no
+            separators, plus a parallel array of character-set signatures.
+            A lookup scans only the groups within the edit bound of the input
+            length, and most candidates are rejected by one popcount on their
+            signature before any distance is computed. */
+        static const size_t max_length = 64;
+
+        std::vector<char> chars[max_length + 1];
+        std::vector<uint64_t> signatures[max_length + 1];
+
+        void add(const std::string& id)
+        {
+            if(id.empty() || id.size() > max_length) return;
+
+            chars[id.size()].insert(chars[id.size()].end(), id.begin(), id.end());
+            signatures[id.size()].push_back(signature(id.data(), id.size()));
+        }
+
+        void remove(const std::string& id)
+        {
+            if(id.empty() || id.size() > max_length) return;
+
+            /*  Swap with the last id of the group, order doesn't matter. */
+            std::vector<char>& group = chars[id.size()];
+            std::vector<uint64_t>& sigs = signatures[id.size()];
+            const size_t n = id.size();
+            for (size_t i = 0; i < sigs.size(); ++i)
+            {
+                if(std::memcmp(&group[i * n], id.data(), n) != 0) continue;
+
+                std::memcpy(&group[i * n], &group[group.size() - n], n);
+                group.resize(group.size() - n);
+                sigs[i] = sigs.back();
+                sigs.pop_back();
+                return;
+            }
+        }
+
+        static uint64_t signature(const char* id, size_t n)
+        {
+            /*  One bit per character class: letters (case folded), digits, '_'
+                and the rest hashed into the remaining bits. popcount of
+                (a & ~b) never exceeds the number of characters of a missing
+                from b, so it's a lower bound on the edit distance. */
+            uint64_t sig = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                unsigned char c = (unsigned char)id[i];
+                unsigned bit;
+                if(c >= 'a' && c <= 'z') bit = c - 'a';
+                else if(c >= 'A' && c <= 'Z') bit = c - 'A';
+                else if(c >= '0' && c <= '9') bit = 26 + (c - '0');
+                else if(c == '_') bit = 36;
+                else bit = 37 + c % 27;
+                sig |= uint64_t(1) << bit;
+            }
+            return sig;
+        }
+
+        static size_t popcount(uint64_t x)
+        {
+            x = x - ((x >> 1) & 0x5555555555555555ULL);
+            x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+            x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return (size_t)((x * 0x0101010101010101ULL) >> 56);
+        }
+    };
+
+    struct path_index
+    {
+        /*  Sorted in-memory index of file paths for completing path arguments
+            (e.g. exec, map, record). rebuild runs the given enumeration on a
+            background thread and swaps the finished index in, so a slow disk
+            never stalls the caller. add and remove apply incremental changes,
+            e.g. from a file system watcher. Completion only reads the
+            in-memory index. */
+        typedef std::vector<std::string> path_list_t;
+
+        ~path_index()
+        {
+            {
+                std::lock_guard<std::mutex> lock(index_mutex);
+                stopping = true;
+            }
+            rebuild_requested.notify_one();
+            if(builder.joinable()) builder.join();
+        }
+
+        void rebuild(std::function<void(path_list_t& paths)> enumerate)
+        {
+            /*  Never waits for a walk in progress: the request is queued for
+                the builder thread (a newer request replaces a queued one), and
+                a walk that finishes after a newer rebuild was requested is
+                thrown away instead of swapped in. */
+            std::lock_guard<std::mutex> lock(index_mutex);
+            pending = enumerate;
+            ++requested_generation;
+            if(!builder.joinable())
+            {
+                builder = std::thread(&path_index::build_loop, this);
+            }
+            rebuild_requested.notify_one();
+        }
+
+        void add(const std::string& path)
+        {
+            /*  Copy-on-write, so completions already handed out stay valid. */
+            std::lock_guard<std::mutex> lock(index_mutex);
+            std::shared_ptr<path_list_t> paths(index ? new path_list_t(*index) : new path_list_t);
+            auto at = std::lower_bound(paths->begin(), paths->end(), path);
+            if(at != paths->end() && *at == path) return;
+            paths->insert(at, path);
+            index = paths;
+        }
+
+        void remove(const std::string& path)
+        {
+            std::lock_guard<std::mutex> lock(index_mutex);
+            if(!index) return;
+            std::shared_ptr<path_list_t> paths(new path_list_t(*index));
+            auto at = std::lower_bound(paths->begin(), paths->end(), path);
+            if(at == paths->end() || *at != path) return;
+            paths->erase(at);
+            index = paths;
+        }
+
+        void complete(const std::string& prefix, std::vector<const std::string*>& out)
+        {
+            {
+                std::lock_guard<std::mutex> lock(index_mutex);
+                served = index;
+            }
+            if(!served) return;
+
+            for (auto it = std::lower_bound(served->begin(), served->end(), prefix);
+                it != served->end() && it->compare(0, prefix.size(), prefix) == 0; ++it)
+            {
+                out.push_back(&*it);
+            }
+        }
+
+        completion_provider_t provider()
+        {
+            return [this](size_t arg_index, const std::string& prefix, std::vector<const std::string*>& out)
+                {
+                    this->complete(prefix, out);
+                };
+        }
+
+    private:
+        void build_loop()
+        {
+            std::unique_lock<std::mutex> lock(index_mutex);
+            for (;;)
+            {
+                rebuild_requested.wait(lock, [this]{ return stopping || pending; });
+                if(stopping) return;
+
+                std::function<void(path_list_t& paths)> enumerate;
+                enumerate.swap(pending);
+                size_t generation = requested_generation;
+                lock.unlock();
+
+                std::shared_ptr<path_list_t> paths(new path_list_t);
+                enumerate(*paths);
+                std::sort(paths->begin(), paths->end());
+
+                lock.lock();
+                if(generation == requested_generation)
+                {
+                    index = paths;
+                }
+            }
+        }
+
+        std::mutex index_mutex;
+        std::condition_variable rebuild_requested;
+        std::shared_ptr<path_list_t> index;
+        std::shared_ptr<path_list_t> served; // keeps the last completions alive
+        std::function<void(path_list_t& paths)> pending;
+        size_t requested_generation = 0;
+        bool stopping = false;
+        std::thread builder;
+    };
+
+    struct counter
+    {
+        /*  Counter for metrics that many threads bump at high rates, e.g.
+            net_packets_in. Each thread adds into its own cache line sized
+            shard, so increments never contend on a shared line. Reading sums
+            the shards. Bind with bind_cvar to read it from the console. */
+        static const size_t shard_count = 16;
+
+        void add(long long n = 1)
+        {
+            shards[shard_index()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        long long value() const
+        {
+            long long sum = 0;
+            for (auto& shard : shards)
+            {
+                sum += shard.value.load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+
+    protected:
+        struct alignas(64) shard_t
+        {
+            shard_t() : value(0) {}
+            std::atomic<long long> value;
+        };
+        shard_t shards[shard_count];
+
+        static size_t shard_index()
+        {
+            static std::atomic<size_t> next_index(0);
+            static thread_local size_t index = next_index.fetch_add(1, std::memory_order_relaxed) % shard_count;
+            return index;
+        }
+    };
+
+    struct gauge : counter
+    {
+        /*  A counter that can also go down or be set, e.g. alloc_count. set
+            adds the difference to the current total, so adds racing with it
+            are not lost. */
+        void sub(long long n = 1)
+        {
+            add(-n);
+        }
+
+        void set(long long v)
+        {
+            add(v - value());
+        }
+    };
+
+    struct spsc_ring
+    {
+        /*  Single-producer single-consumer ring of length-prefixed messages.
+            It is fixed size, holds no pointers and only uses lock-free
+            atomics, so it can be placed in memory shared between processes
+            (construct it there with placement new). head and tail are free
+            running byte counters on separate cache lines. */
+        static const uint32_t capacity = 1 << 16;
+
+        spsc_ring() : head(0), tail(0) {}
+
+        uint32_t free_space() const
+        {
+            return capacity - (tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+        }
+
+        bool push(const char* msg, uint32_t size)
+        {
+            uint32_t t = tail.load(std::memory_order_relaxed);
+            uint32_t h = head.load(std::memory_order_acquire);
+            if(capacity - (t - h) < size + sizeof(size)) return false;
+
+            copy_in(t, (const char*)&size, sizeof(size));
+            copy_in(t + sizeof(size), msg, size);
+            tail.store(t + sizeof(size) + size, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(std::string& out)
+        {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            uint32_t t = tail.load(std::memory_order_acquire);
+            if(h == t) return false;
+
+            uint32_t size;
+            copy_out(h, (char*)&size, sizeof(size));
+            out.resize(size);
+            if(size) copy_out(h + sizeof(size), &out[0], size);
+            head.store(h + sizeof(size) + size, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        alignas(64) std::atomic<uint32_t> head;
+        alignas(64) std::atomic<uint32_t> tail;
+        alignas(64) char data[capacity];
+
+        void copy_in(uint32_t at, const char* src, uint32_t size)
+        {
+            uint32_t offset = at % capacity;
+            uint32_t first = std::min(size, capacity - offset);
+            std::memcpy(data + offset, src, first);
+            std::memcpy(data, src + first, size - first);
+        }
+
+        void copy_out(uint32_t at, char* dst, uint32_t size) const
+        {
+            uint32_t offset = at % capacity;
+            uint32_t first = std::min(size, capacity - offset);
+            std::memcpy(dst, data + offset, first);
+            std::memcpy(dst + first, data, size - first);
+        }
+    };
+
+    struct command_channel
+    {
+        /*  Bidirectional channel for tools on the same machine (profiler UI,
+            editor) to send console commands without going through sockets.
+            The tool pushes commands to requests and pops their output from
+            responses; the game executes them in console::pump(channel).
+            Responses longer than max_response are cut short. */
+        static const uint32_t max_response = spsc_ring::capacity / 8;
+
+        spsc_ring requests;
+        spsc_ring responses;
+    };
+
+    inline int& no_alloc_depth()
+    {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    struct no_alloc_scope
+    {
+        /*  Marks code on this thread that must not allocate, e.g.
+            { noclip::no_alloc_scope guard; console.execute(line, out); }
+            Only checked when NOCLIP_CHECK_ALLOCATIONS is defined (see the
+            end of this file); otherwise it costs a thread-local increment. */
+        no_alloc_scope() { ++no_alloc_depth(); }
+        ~no_alloc_scope() { --no_alloc_depth(); }
+    };
+
+    template<typename T>
+    struct alignas(64) hot
+    {
+        /*  Wrapper for frequently written CVars such as per-frame stats. It
+            occupies whole cache lines of its own, so writes to it don't
+            invalidate the lines of read-mostly config variables placed
+            next to it. bind_cvar binds the wrapped value, so the CVar's type
+            is T. (Heap allocations only honour the alignment from C++17.) */
+        T value = T();
+    };
+
+    template<typename T>
+    struct latched
+    {
+        /*  Frame-latched CVar. 'set' writes pending and the value only changes
+            when console::latch() publishes it, so jobs reading value during a
+            frame all see the same thing without atomics. Call latch() at the
+            frame boundary, while no job is reading. */
+        T value = T();
+        T pending = T();
+        bool dirty = false;
+    };
+
+    struct console;
+
+    struct cvar_ref
+    {
+        void* mem = nullptr;
+        const std::type_info* type = nullptr;
+
+        /*  Set for arithmetic CVars, which presets store as raw bytes: the
+            size of the value and a function parsing text into it. */
+        size_t size = 0;
+        bool (*parse)(console& c, std::istream& is, std::ostream& os, void* out) = nullptr;
+    };
+
     struct console
     {
         console()
         {
-            bind_builtin_commands();
+            bind_builtin_commands();
+
+            /*  Builtins bound through cmd_slot (the generators) are already in
+                the pool, the others were assigned straight into cmd_table.
+                Refill it so each id is in it exactly once. */
+            cmd_names = name_pool();
+            for (auto& it : cmd_table)
+            {
+                builtin_ids.insert(it.first);
+                cmd_names.add(it.first);
+            }
+        }
+
+        typedef std::map<std::string, console_function_t> function_table_t;
+        function_table_t cvar_setter_lambdas;
+        function_table_t cvar_getter_lambdas;
+
+        /*  The bound commands, read only (e.g. for suggest). Bind and unbind
+            them with bind_cmd and unbind_cmd. */
+        const function_table_t& commands() const
+        {
+            return cmd_table;
+        }
+
+        /*  Typed addresses of bound CVars. A cvar_id_t is a pointer to an entry
+            of this table; it stays valid until the CVar is unbound, so game
+            code can look ids up once and reuse them with read_many/write_many. */
+        typedef std::map<std::string, cvar_ref> cvar_ref_table_t;
+        typedef const cvar_ref_table_t::value_type* cvar_id_t;
+        cvar_ref_table_t cvar_refs;
+
+        /*  When enabled, 'set' on a CVar that isn't bound yet keeps the value
+            text in pending_values instead of failing, and bind_cvar applies it
+            when the CVar is bound. Lets a config be executed at the very start
+            of the program, before subsystems bind their CVars. Like the rest
+            of the console this isn't synchronised: 'set' and bind_cvar must
+            run on the same thread. A config read on a worker thread while
+            subsystems initialise should enqueue its lines for pump instead.
+            Errors from applying a pending value are discarded. */
+        bool keep_pending_values = false;
+        std::map<std::string, std::string> pending_values;
+
+        /*  Called with the ids of CVars changed through the console: once per
+            set, and once per write_many with every id it changed. */
+        std::function<void(const std::vector<const std::string*>& vids)> on_cvars_changed;
+
+        template<typename T>
+        void bind_cvar(const std::string& vid, T* vmem)
+        {
+            cvar_id_t id = add_cvar_ref(vid, vmem);
+            cvar_setter_lambdas[vid] = make_cvar_setter(id, vmem);
+            cvar_getter_slot(vid) = make_cvar_getter(vmem);
+
+            apply_pending_value(vid);
+        }
+
+        template<typename T>
+        void bind_cvar(const std::string& vid, hot<T>* vmem)
+        {
+            bind_cvar(vid, &vmem->value);
+        }
+
+        template<typename T>
+        void bind_cvar(const std::string& vid, latched<T>* vmem)
+        {
+            cvar_id_t id = add_cvar_ref(vid, vmem);
+            vmem->dirty = false; // any latch it had pending was dropped
+
+            cvar_setter_lambdas[vid] =
+                [this, id, vmem](std::istream& is, std::ostream& os)
+                {
+                    T read = this->evaluate_argument<T>(is, os);
+
+                    if(is.fail())
+                    {
+                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << id->first
+                        << "' is of type '" << typeid(T).name() << "'." << std::endl;
+
+                        is.clear();
+                    }
+                    else
+                    {
+                        vmem->pending = read;
+                        if(!vmem->dirty)
+                        {
+                            vmem->dirty = true;
+                            this->dirty_latches.push_back(std::make_pair(id, &console::publish_latched<T>));
+                        }
+                    }
+                };
+
+            cvar_getter_slot(vid) =
+                [vmem](std::istream& is, std::ostream& os)
+                {
+                    os << (vmem->dirty ? vmem->pending : vmem->value) << std::endl;
+                };
+
+            apply_pending_value(vid);
+        }
+
+        void latch()
+        {
+            /*  Publishes every latched CVar set since the last latch and reports
+                them to on_cvars_changed in a single call. */
+            if(dirty_latches.empty()) return;
+
+            for (auto& latch : dirty_latches)
+            {
+                latch.second(latch.first->second.mem);
+                mark_changed(latch.first);
+            }
+            dirty_latches.clear();
+
+            notify_changed();
+        }
+
+        void bind_cvar(const std::string& vid, counter* vmem)
+        {
+            /* Counters are read-only from the console. */
+            erase_cvar_ref(vid);
+
+            cvar_setter_lambdas[vid] =
+                [vid](std::istream& is, std::ostream& os)
+                {
+                    os << "NOCLIP::CONSOLE ERROR: CVar '" << vid << "' is read-only." << std::endl;
+                };
+
+            cvar_getter_slot(vid) =
+                [vmem](std::istream& is, std::ostream& os)
+                {
+                    os << vmem->value() << std::endl;
+                };
+        }
+
+        void bind_cvar(const std::string& vid, gauge* vmem)
+        {
+            erase_cvar_ref(vid);
+
+            cvar_setter_lambdas[vid] =
+                [this, vid, vmem](std::istream& is, std::ostream& os)
+                {
+                    long long read = this->evaluate_argument<long long>(is, os);
+
+                    if(is.fail())
+                    {
+                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << vid
+                        << "' is of type '" << typeid(long long).name() << "'." << std::endl;
+
+                        is.clear();
+                    }
+                    else
+                    {
+                        vmem->set(read);
+                    }
+                };
+
+            cvar_getter_slot(vid) =
+                [vmem](std::istream& is, std::ostream& os)
+                {
+                    os << vmem->value() << std::endl;
+                };
+
+            apply_pending_value(vid);
+        }
+
+        /*  Boolean CVars packed into a bitset, for large numbers of debug and
+            feature toggles. Each flag is a bit of flag_bits and may belong to
+            a group. Whole groups (or every flag matching a glob such as
+            'r_debug_*') are set, cleared or toggled a word at a time with
+            set_flags or the 'flags' builtin. Game code reads a flag with
+            test_flag, a single bit test. */
+        typedef size_t flag_id_t;
+        enum flag_op { flag_set, flag_clear, flag_toggle };
+        std::vector<uint64_t> flag_bits;
+        std::map<std::string, std::vector<uint64_t>> flag_groups;
+        std::map<std::string, flag_id_t> flag_ids;
+
+        flag_id_t bind_flag(const std::string& vid, const std::string& group = "", bool value = false)
+        {
+            erase_cvar_ref(vid);
+
+            flag_id_t id;
+            auto f_iter = flag_ids.find(vid);
+            if(f_iter != flag_ids.end())
+            {
+                id = f_iter->second;
+                remove_flag_from_groups(id); // rebinding may move it to another group
+            }
+            else
+            {
+                id = flag_count++;
+                flag_bits.resize(flag_count / 64 + 1);
+                flag_ids[vid] = id;
+            }
+            set_flag(id, value);
+
+            if(!group.empty())
+            {
+                std::vector<uint64_t>& mask = flag_groups[group];
+                mask.resize(flag_bits.size());
+                mask[id / 64] |= uint64_t(1) << (id % 64);
+            }
+
+            cvar_setter_lambdas[vid] =
+                [this, vid, id](std::istream& is, std::ostream& os)
+                {
+                    bool read = this->evaluate_argument<bool>(is, os);
+
+                    if(is.fail())
+                    {
+                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << vid
+                        << "' is of type '" << typeid(bool).name() << "'." << std::endl;
+
+                        is.clear();
+                    }
+                    else
+                    {
+                        this->set_flag(id, read);
+                    }
+                };
+
+            cvar_getter_slot(vid) =
+                [this, id](std::istream& is, std::ostream& os)
+                {
+                    os << this->test_flag(id) << std::endl;
+                };
+
+            apply_pending_value(vid);
+            return id;
+        }
+
+        bool test_flag(flag_id_t id) const
+        {
+            return (flag_bits[id / 64] >> (id % 64)) & 1;
+        }
+
+        void set_flag(flag_id_t id, bool value)
+        {
+            uint64_t bit = uint64_t(1) << (id % 64);
+            flag_bits[id / 64] = value ? (flag_bits[id / 64] | bit) : (flag_bits[id / 64] & ~bit);
+        }
+
+        size_t set_flags(const std::string& group_or_glob, flag_op op)
+        {
+            /*  Applies op to every flag of the group, or if there is no such
+                group, to every flag whose id matches the glob ('*' and '?').
+                Returns how many flags were affected. */
+            std::vector<uint64_t> glob_mask;
+            const std::vector<uint64_t>* mask = &glob_mask;
+
+            auto g_iter = flag_groups.find(group_or_glob);
+            if(g_iter != flag_groups.end())
+            {
+                mask = &g_iter->second;
+            }
+            else
+            {
+                glob_mask.resize(flag_bits.size());
+                for (auto& it : flag_ids)
+                {
+                    if(glob_match(group_or_glob.c_str(), it.first.c_str()))
+                    {
+                        glob_mask[it.second / 64] |= uint64_t(1) << (it.second % 64);
+                    }
+                }
+            }
+
+            size_t affected = 0;
+            for (size_t i = 0; i < mask->size(); ++i)
+            {
+                uint64_t m = (*mask)[i];
+                if(op == flag_set) flag_bits[i] |= m;
+                else if(op == flag_clear) flag_bits[i] &= ~m;
+                else flag_bits[i] ^= m;
+
+                for (; m; m &= m - 1) ++affected;
+            }
+            return affected;
+        }
+
+        template<typename F>
+        void bind_computed_cvar(const std::string& vid, F getter, double ttl_seconds = 0.0)
+        {
+            /*  Read-only CVar whose value comes from calling getter, e.g. for
+                runtime statistics that are expensive to compute. The getter
+                only runs when the CVar is read, and its result is reused for
+                ttl_seconds afterwards (0 means recompute on every read). */
+            typedef typename std::decay<decltype(getter())>::type T;
+            typedef std::chrono::steady_clock clock;
+
+            erase_cvar_ref(vid);
+
+            bool cached = false;
+            T value = T();
+            clock::time_point computed_at;
+
+            cvar_setter_lambdas[vid] =
+                [vid](std::istream& is, std::ostream& os)
+                {
+                    os << "NOCLIP::CONSOLE ERROR: CVar '" << vid << "' is read-only." << std::endl;
+                };
+
+            cvar_getter_slot(vid) =
+                [getter, ttl_seconds, cached, value, computed_at](std::istream& is, std::ostream& os) mutable
+                {
+                    clock::time_point now = clock::now();
+                    if(!cached || now - computed_at >= std::chrono::duration<double>(ttl_seconds))
+                    {
+                        value = getter();
+                        computed_at = now;
+                        cached = true;
+                    }
+                    os << value << std::endl;
+                };
+        }
+
+        template<typename ... Args>
+        void bind_cmd(const std::string& cid, void(*f_ptr)(Args ...))
+        {
+            cmd_slot(cid) = make_cmd(f_ptr);
+        }
+
+        template<typename O, typename ... Args> /* Use :: syntax e.g. bind_cmd("name", &A::f, &a) */
+        void bind_cmd(const std::string& cid, void(O::*f_ptr)(Args ...), O* omem)
+        {
+            cmd_slot(cid) = make_cmd(f_ptr, omem);
+        }
+
+        void bind_cmd(const std::string& cid, console_function_t iofunc)
+        {
+            cmd_slot(cid) = iofunc;
+        }
+
+        /*  Registrations collected up front and applied with bind_many. Closures
+            for commands are built as they are added; CVar closures are built by
+            bind_many once the CVar's id exists. Plain and string CVars only. */
+        struct registration_batch
+        {
+            explicit registration_batch(console& owner) : owner(owner) {}
+
+            void reserve(size_t cvar_count, size_t cmd_count)
+            {
+                cvars.reserve(cvar_count);
+                cmds.reserve(cmd_count);
+            }
+
+            template<typename T>
+            void cvar(const std::string& vid, T* vmem)
+            {
+                cvars.push_back(cvar_desc{ vid, vmem, &console::make_cvar_lambdas<T> });
+            }
+
+            template<typename T>
+            void cvar(const std::string& vid, hot<T>* vmem)
+            {
+                cvar(vid, &vmem->value);
+            }
+
+            template<typename ... Args>
+            void cmd(const std::string& cid, void(*f_ptr)(Args ...))
+            {
+                cmds.push_back(cmd_desc{ cid, owner.make_cmd(f_ptr) });
+            }
+
+            template<typename O, typename ... Args>
+            void cmd(const std::string& cid, void(O::*f_ptr)(Args ...), O* omem)
+            {
+                cmds.push_back(cmd_desc{ cid, owner.make_cmd(f_ptr, omem) });
+            }
+
+            void cmd(const std::string& cid, console_function_t iofunc)
+            {
+                cmds.push_back(cmd_desc{ cid, std::move(iofunc) });
+            }
+
+            struct cvar_desc
+            {
+                std::string id;
+                void* mem;
+                void(*make)(console&, cvar_ref_table_t::value_type&, void*, console_function_t&, console_function_t&);
+            };
+
+            struct cmd_desc
+            {
+                std::string id;
+                console_function_t func;
+            };
+
+            console& owner;
+            std::vector<cvar_desc> cvars;
+            std::vector<cmd_desc> cmds;
+        };
+
+        void bind_many(registration_batch& batch)
+        {
+            /*  Descriptors are sorted by id once, then every table is filled in a
+                single ascending pass where each insert is hinted with the position
+                after the previous one, so consecutive ids don't descend the tree
+                from the root. When an id appears twice the last one wins, like
+                repeated bind calls. The batch is empty afterwards. */
+            auto& cvars = batch.cvars;
+            std::stable_sort(cvars.begin(), cvars.end(),
+                [](const registration_batch::cvar_desc& a, const registration_batch::cvar_desc& b){ return a.id < b.id; });
+
+            if(!cvars.empty())
+            {
+                auto ref_hint = cvar_refs.lower_bound(cvars.front().id);
+                auto set_hint = cvar_setter_lambdas.lower_bound(cvars.front().id);
+                auto get_hint = cvar_getter_lambdas.lower_bound(cvars.front().id);
+                console_function_t setter, getter;
+
+                for (size_t i = 0; i < cvars.size(); ++i)
+                {
+                    auto& d = cvars[i];
+                    if(i + 1 < cvars.size() && cvars[i + 1].id == d.id) continue;
+
+                    auto v_ref_iter = cvar_refs.emplace_hint(ref_hint, d.id, cvar_ref());
+                    ref_hint = std::next(v_ref_iter);
+                    if(!dirty_latches.empty()) forget_latch(&*v_ref_iter);
+
+                    d.make(*this, *v_ref_iter, d.mem, setter, getter);
+                    set_hint = insert_hinted(cvar_setter_lambdas, set_hint, d.id, std::move(setter));
+                    size_t cvar_count = cvar_getter_lambdas.size();
+                    get_hint = insert_hinted(cvar_getter_lambdas, get_hint, d.id, std::move(getter));
+                    if(cvar_getter_lambdas.size() != cvar_count) cvar_names.add(d.id);
+                }
+
+                for (auto& d : cvars)
+                {
+                    apply_pending_value(d.id);
+                }
+            }
+
+            auto& cmds = batch.cmds;
+            std::stable_sort(cmds.begin(), cmds.end(),
+                [](const registration_batch::cmd_desc& a, const registration_batch::cmd_desc& b){ return a.id < b.id; });
+
+            if(!cmds.empty())
+            {
+                auto cmd_hint = cmd_table.lower_bound(cmds.front().id);
+                for (size_t i = 0; i < cmds.size(); ++i)
+                {
+                    if(i + 1 < cmds.size() && cmds[i + 1].id == cmds[i].id) continue;
+                    size_t cmd_count = cmd_table.size();
+                    cmd_hint = insert_hinted(cmd_table, cmd_hint, cmds[i].id, std::move(cmds[i].func));
+                    if(cmd_table.size() != cmd_count) cmd_names.add(cmds[i].id);
+                    builtin_ids.erase(cmds[i].id);
+                    generator_table.erase(cmds[i].id);
+                    replace_math_op(cmds[i].id);
+                }
+            }
+
+            cvars.clear();
+            cmds.clear();
+        }
+
+        bool define_preset(const std::string& name, const std::string& script, std::ostream& output)
+        {
+            /*  Compiles a script of 'set <cvar id> <value>' lines into a preset.
+                Values of bound arithmetic CVars are evaluated now and stored as
+                raw bytes, so applying the preset is a memcpy per CVar. Other
+                lines (string CVars, CVars not bound yet, other commands) are
+                kept as text and executed when the preset is applied. Setting
+                the same CVar twice keeps the last value. Returns false, leaving
+                any previous preset of that name, if a value fails to parse. */
+            preset compiled;
+            std::istringstream script_stream(script);
+            std::string line;
+            while(std::getline(script_stream, line))
+            {
+                if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+                std::istringstream line_stream(line);
+                std::string cmd_id, vid;
+                line_stream >> cmd_id >> vid;
+
+                auto v_ref_iter = cvar_refs.find(vid);
+                if(cmd_id != "set" || v_ref_iter == cvar_refs.end() || !v_ref_iter->second.parse)
+                {
+                    compiled.script += line;
+                    compiled.script += '\n';
+                    continue;
+                }
+
+                const cvar_ref& ref = v_ref_iter->second;
+
+                union { long double ld; long long ll; unsigned char bytes[sizeof(long double)]; } value;
+                if(!ref.parse(*this, line_stream, output, value.bytes))
+                {
+                    output << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << vid
+                    << "' is of type '" << ref.type->name() << "'." << std::endl;
+                    return false;
+                }
+
+                preset_patch* patch = nullptr;
+                for (auto& existing : compiled.patches)
+                {
+                    if(existing.id == &*v_ref_iter) patch = &existing;
+                }
+                if(!patch)
+                {
+                    compiled.patches.push_back(preset_patch{ &*v_ref_iter, ref.type, compiled.bytes.size(), ref.size, std::string() });
+                    compiled.bytes.resize(compiled.bytes.size() + ref.size);
+                    patch = &compiled.patches.back();
+                }
+
+                std::memcpy(&compiled.bytes[patch->offset], value.bytes, ref.size);
+                patch->line = line;
+            }
+
+            presets[name] = std::move(compiled);
+            return true;
+        }
+
+        bool apply_preset(const std::string& name, std::ostream& output)
+        {
+            /*  Writes every compiled value in one pass, runs the preset's text
+                lines, then reports every CVar that actually changed to
+                on_cvars_changed in a single call. A patch whose CVar was
+                unbound or rebound with another type since the preset was
+                defined runs its original 'set' line instead. */
+            auto p_iter = presets.find(name);
+            if(p_iter == presets.end()) return false;
+
+            const preset& p = p_iter->second;
+            ++notifications_held;
+            for (auto& patch : p.patches)
+            {
+                if(!patch.id || *patch.type != *patch.id->second.type)
+                {
+                    execute_batch(patch.line, output);
+                    continue;
+                }
+                if(patch_matches(p, patch)) continue;
+
+                std::memcpy(patch.id->second.mem, &p.bytes[patch.offset], patch.size);
+                mark_changed(patch.id);
+            }
+
+            if(!p.script.empty())
+            {
+                execute_batch(p.script, output);
+            }
+            --notifications_held;
+
+            notify_changed();
+            return true;
+        }
+
+        const std::string* active_preset() const
+        {
+            /*  The first preset whose compiled values all equal the current
+                ones, or nullptr. Text lines aren't compared. */
+            for (auto& it : presets)
+            {
+                const preset& p = it.second;
+                bool matches = !p.patches.empty();
+                for (size_t i = 0; matches && i < p.patches.size(); ++i)
+                {
+                    matches = patch_matches(p, p.patches[i]);
+                }
+                if(matches) return &it.first;
+            }
+            return nullptr;
+        }
+
+        void unbind_cvar(const std::string& vid)
+        {
+            auto v_set_iter = cvar_setter_lambdas.find(vid);
+            if(v_set_iter != cvar_setter_lambdas.end())
+            {
+                cvar_setter_lambdas.erase(v_set_iter);
+            }
+
+            auto v_get_iter = cvar_getter_lambdas.find(vid);
+            if(v_get_iter != cvar_getter_lambdas.end())
+            {
+                cvar_getter_lambdas.erase(v_get_iter);
+                cvar_names.remove(vid);
+            }
+
+            cvar_policies.erase(vid);
+
+            erase_cvar_ref(vid);
+
+            auto f_iter = flag_ids.find(vid);
+            if(f_iter != flag_ids.end())
+            {
+                remove_flag_from_groups(f_iter->second);
+                flag_ids.erase(f_iter);
+            }
+        }
+
+        cvar_id_t find_cvar(const std::string& vid) const
+        {
+            auto v_ref_iter = cvar_refs.find(vid);
+            return v_ref_iter == cvar_refs.end() ? nullptr : &*v_ref_iter;
+        }
+
+        template<typename ... Ts>
+        size_t read_many(const cvar_id_t* ids, Ts&... outs) const
+        {
+            /*  Gathers the values of ids[0..n) into outs in one pass, e.g.
+                read_many(ids, settings.fov, settings.sensitivity, settings.name);
+                Ids that are null or whose CVar type doesn't match the
+                corresponding out are skipped. Returns how many were read. */
+            return read_cvar(ids, outs...);
+        }
+
+        template<typename ... Ts>
+        size_t write_many(const cvar_id_t* ids, const Ts&... values)
+        {
+            /*  Scatters values into the CVars ids[0..n) in one pass. Every
+                changed id is reported to on_cvars_changed in a single call.
+                Returns how many were written. */
+            size_t written = write_cvar(ids, values...);
+            notify_changed();
+            return written;
+        }
+
+        void bind_generator(const std::string& cid, generator_factory_t factory)
+        {
+            /*  Executing the command drains the generator in one go; open lets
+                a consumer (socket, pager, GUI) pull the chunks at its own pace. */
+            cmd_slot(cid) =
+                [factory](std::istream& is, std::ostream& os)
+                {
+                    generator_t gen = factory(is, os);
+                    while(gen && gen(os));
+                };
+
+            generator_table[cid] = factory;
+        }
+
+        generator_t open(const std::string& str, std::ostream& output)
+        {
+            /*  Starts the command in str and returns a generator for its output.
+                Commands bound with bind_generator produce their output chunk by
+                chunk; any other command runs here and its whole output becomes
+                a single chunk. The generator refers to the console, so it must
+                not outlive it. Errors are written to output and an empty
+                generator is returned. */
+            std::stringstream line_stream;
+            line_stream.str(str);
+
+            std::string cmd_id;
+            line_stream >> cmd_id;
+
+            auto gen_iter = generator_table.find(cmd_id);
+            if(gen_iter != generator_table.end())
+            {
+                return gen_iter->second(line_stream, output);
+            }
+
+            auto cmd_iter = find_cmd(cmd_id);
+            if(cmd_iter == cmd_table.end())
+            {
+                output << "NOCLIP::CONSOLE ERROR: Input '" << cmd_id << "' isn't a command.";
+                output_suggestion(output, cmd_id, cmd_table);
+                output << std::endl;
+                return generator_t();
+            }
+
+            std::ostringstream result;
+            (cmd_iter->second)(line_stream, result);
+            std::string text = result.str();
+            return
+                [text](std::ostream& os)
+                {
+                    os << text;
+                    return false;
+                };
+        }
+
+        std::map<std::string, generator_factory_t> generator_table;
+        size_t list_chunk_lines = 64;
+
+        void unbind_cmd(const std::string& cid)
+        {
+            auto cmd_iter = cmd_table.find(cid);
+            if(cmd_iter != cmd_table.end())
+            {
+                for (size_t i = 0; i < dispatch_cache_size; ++i)
+                {
+                    if(dispatch_cache_uses[i] && dispatch_cache_iters[i] == cmd_iter)
+                    {
+                        dispatch_cache_uses[i] = 0;
+                    }
+                }
+                cmd_table.erase(cmd_iter);
+                cmd_names.remove(cid);
+            }
+
+            completion_providers.erase(cid);
+            generator_table.erase(cid);
+            replace_math_op(cid);
+        }
+
+        void execute(std::istream& input, std::ostream& output)
+        {
+            /*  Ids are read into member scratch strings (here and in set/get),
+                so long ids don't allocate on every call. Nested expressions
+                reuse them, which is fine: the id is only needed up to the
+                point where the command runs. */
+            std::string& cmd_id = cmd_id_scratch;
+            input >> cmd_id;
+
+            auto cmd_iter = find_cmd(cmd_id);
+            if(cmd_iter == cmd_table.end())
+            {
+                output << "NOCLIP::CONSOLE ERROR: Input '" << cmd_id << "' isn't a command.";
+                output_suggestion(output, cmd_id, cmd_table);
+                output << std::endl;
+                return;
+            }
+
+            (cmd_iter->second)(input, output);
+        }
+
+        void execute(const std::string& str, std::ostream& output)
+        {
+            std::stringstream line_stream;
+            line_stream.str(str);
+            execute(line_stream, output);
+        }
+
+        void execute_batch(std::istream& input, std::ostream& output)
+        {
+            /*  Executes every line of input as its own command until the input
+                is exhausted. Lets a frontend (e.g. a remote admin connection)
+                deliver many commands in one message and get every result back
+                in one output. Blank lines are skipped. */
+            std::string line;
+            while(std::getline(input, line))
+            {
+                if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+                execute(line, output);
+            }
+        }
+
+        void execute_batch(const std::string& str, std::ostream& output)
+        {
+            std::stringstream batch_stream;
+            batch_stream.str(str);
+            execute_batch(batch_stream, output);
+        }
+
+        void enqueue(const std::string& str)
+        {
+            /*  Thread-safe. Queues a command (or a batch of lines) to be executed
+                on the next call to pump. Lets input be gathered on another
+                thread, e.g. a stdin reader, without blocking the main loop. */
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            command_queue.push_back(str);
+        }
+
+        /*  How rapid successive sets of one CVar are handled, e.g. for sets sent
+            by a UI slider on every pixel of movement:
+            coalesce - every set is applied at once, so readers see intermediate
+                       values, but on_cvars_changed is reported at most once per
+                       window, at its end.
+            debounce - sets are held; window seconds after the first held set,
+                       the latest one is applied (once) and reported. Readers
+                       never see intermediate values.
+            Held sets are flushed by pump(), or by calling flush_held_sets. */
+        enum set_policy { set_immediate, set_coalesce, set_debounce };
+
+        void set_cvar_policy(const std::string& vid, set_policy policy, double window_seconds)
+        {
+            if(policy == set_immediate)
+            {
+                cvar_policies.erase(vid);
+                return;
+            }
+
+            cvar_policy& p = cvar_policies[vid];
+            p.policy = policy;
+            p.window = std::chrono::duration_cast<policy_clock::duration>(std::chrono::duration<double>(window_seconds));
+        }
+
+        void flush_held_sets(std::ostream& output)
+        {
+            if(cvar_policies.empty()) return;
+
+            policy_clock::time_point now = policy_clock::now();
+            std::vector<const std::string*> changed;
+            for (auto& it : cvar_policies)
+            {
+                cvar_policy& p = it.second;
+                if(!p.held || now < p.deadline) continue;
+
+                p.held = false;
+                if(p.policy == set_coalesce)
+                {
+                    changed.push_back(&it.first);
+                    continue;
+                }
+
+                auto v_iter = cvar_setter_lambdas.find(it.first);
+                if(v_iter != cvar_setter_lambdas.end())
+                {
+                    std::istringstream value(p.value);
+                    (v_iter->second)(value, output);
+                }
+            }
+
+            if(!changed.empty() && on_cvars_changed)
+            {
+                on_cvars_changed(changed);
+            }
+        }
+
+        void pump(std::ostream& output)
+        {
+            /*  Executes every queued command on the calling thread. Call this
+                once per tick from the main loop. The queue is swapped out under
+                the lock so producers never wait on command execution. */
+            flush_held_sets(output);
+
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                pumped_commands.swap(command_queue);
+            }
+
+            for (auto& str : pumped_commands)
+            {
+                execute_batch(str, output);
+            }
+            pumped_commands.clear();
+        }
+
+        void complete(const std::string& input, std::vector<const std::string*>& out) const
+        {
+            /*  Fills out with every string that completes the last word of input.
+                The first word completes against command ids. Arguments are
+                completed by the command's provider (see bind_completion),
+                e.g. set and get complete CVar ids. Results point at strings
+                owned by the console or provider, so no strings are copied.
+                Tables are sorted, so the matches are the contiguous range
+                starting at lower_bound of the prefix. */
+            out.clear();
+
+            size_t word_start = input.find_last_of(" \t");
+            word_start = (word_start == std::string::npos) ? 0 : word_start + 1;
+            std::string prefix = input.substr(word_start);
+
+            std::istringstream preceding(input.substr(0, word_start));
+            std::string cmd_id;
+            size_t preceding_words = 0;
+            for (std::string word; preceding >> word; ++preceding_words)
+            {
+                if(preceding_words == 0) cmd_id = word;
+            }
+
+            if(preceding_words == 0)
+            {
+                complete_from(cmd_table, prefix, out);
+                return;
+            }
+
+            auto p_iter = completion_providers.find(cmd_id);
+            if(p_iter != completion_providers.end())
+            {
+                (p_iter->second)(preceding_words - 1, prefix, out);
+            }
+        }
+
+        std::map<std::string, completion_provider_t> completion_providers;
+
+        void bind_completion(const std::string& cid, completion_provider_t provider)
+        {
+            completion_providers[cid] = provider;
+        }
+
+        const std::string* suggest(const std::string& id, const function_table_t& table, size_t max_distance = 2) const
+        {
+            /*  Returns the id in table closest to id by edit distance, or nullptr
+                if nothing is within max_distance; ties go to the id that sorts
+                first. Used for "did you mean" hints when a command or CVar id
+                isn't found. Distances are computed with Myers' bit-parallel
+                algorithm (one 64-bit word per column) and each comparison
+                exits early once it can no longer beat the best match so far.
+                cmd_table and the CVar tables are searched through their
+                name_pool; other tables are walked. Ids longer than 64
+                characters get no suggestion. */
+            const size_t m = id.size();
+            if(m == 0 || m > name_pool::max_length) return nullptr;
+
+            uint64_t peq[256] = {};
+            for (size_t i = 0; i < m; ++i)
+            {
+                peq[(unsigned char)id[i]] |= uint64_t(1) << i;
+            }
+
+            const name_pool* pool = &table == &cmd_table ? &cmd_names
+                : (&table == &cvar_getter_lambdas || &table == &cvar_setter_lambdas) ? &cvar_names : nullptr;
+            if(!pool)
+            {
+                const std::string* best = nullptr;
+                size_t bound = max_distance;
+                for (auto& it : table)
+                {
+                    size_t distance = bounded_distance(peq, id, it.first.data(), it.first.size(), bound);
+                    if(distance <= bound && distance > 0 && (distance < bound || !best))
+                    {
+                        best = &it.first;
+                        bound = distance;
+                    }
+                }
+                return best;
+            }
+
+            const uint64_t id_sig = name_pool::signature(id.data(), m);
+            const char* best = nullptr;
+            size_t best_n = 0;
+            size_t bound = max_distance;
+            size_t lo = m > max_distance ? m - max_distance : 1;
+            size_t hi = std::min(m + max_distance, (size_t)name_pool::max_length);
+            for (size_t n = lo; n <= hi; ++n)
+            {
+                if((n > m ? n - m : m - n) > bound) continue;
+
+                const std::vector<uint64_t>& sigs = pool->signatures[n];
+                const char* names = pool->chars[n].data();
+                for (size_t i = 0; i < sigs.size(); ++i)
+                {
+                    if(name_pool::popcount(sigs[i] & ~id_sig) > bound
+                        || name_pool::popcount(id_sig & ~sigs[i]) > bound) continue;
+
+                    const char* candidate = names + i * n;
+                    size_t distance = bounded_distance(peq, id, candidate, n, bound);
+                    if(distance > bound || distance == 0) continue;
+
+                    int order = best ? std::memcmp(candidate, best, std::min(n, best_n)) : 0;
+                    if(distance < bound || !best || order < 0 || (order == 0 && n < best_n))
+                    {
+                        best = candidate;
+                        best_n = n;
+                        bound = distance;
+                    }
+                }
+            }
+
+            if(!best) return nullptr;
+            auto it = table.find(std::string(best, best_n));
+            return it == table.end() ? nullptr : &it->first;
+        }
+
+        bool load_help_file(const std::string& path)
+        {
+            /*  Indexes a help file for 'help <id>'. The file is a list of entries,
+                each starting with a line '@<id>' followed by its help text:
+
+                    @sv_cheats
+                    Enables cheats. 0 = off, 1 = on.
+
+                Only a hash of each id and the file offset of its entry are
+                kept in memory. The text is read from the file when it is
+                asked for, so documentation costs almost no resident memory. */
+            std::ifstream file(path, std::ios::binary);
+            if(!file) return false;
+
+            help_path = path;
+            help_index.clear();
+
+            std::string line;
+            std::streamoff offset = 0;
+            while(std::getline(file, line))
+            {
+                if(!line.empty() && line[0] == '@')
+                {
+                    std::string id = line.substr(1, line.find_last_not_of(" \t\r"));
+                    help_index.insert(std::make_pair(std::hash<std::string>()(id), offset));
+                }
+                offset += (std::streamoff)line.size() + 1;
+            }
+            return true;
+        }
+
+        bool print_help(const std::string& id, std::ostream& os) const
+        {
+            /*  Outputs the help text of id from the help file. Returns false if
+                there is none. Also useful for completion tooltips. */
+            auto range = help_index.equal_range(std::hash<std::string>()(id));
+            if(range.first == range.second) return false;
+
+            std::ifstream file(help_path, std::ios::binary);
+            std::string line;
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                file.clear();
+                file.seekg(it->second);
+                std::getline(file, line);
+                if(line.compare(1, line.find_last_not_of(" \t\r"), id) != 0) continue; // hash collision
+
+                while(std::getline(file, line) && (line.empty() || line[0] != '@'))
+                {
+                    if(!line.empty() && line.back() == '\r') line.pop_back();
+                    os << line << std::endl;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        /*  Hit-rate metrics of the dispatch cache in front of cmd_table. */
+        size_t dispatch_cache_hits = 0;
+        size_t dispatch_cache_misses = 0;
+
+        std::deque<std::string> history;
+        size_t max_history = 128;
+
+        void add_history(const std::string& line)
+        {
+            /*  Frontends call this with each line the user submits. Blank lines
+                and immediate repeats are not recorded. Oldest lines are dropped
+                once max_history is reached. */
+            if(line.find_first_not_of(" \t\r") == std::string::npos) return;
+            if(!history.empty() && history.back() == line) return;
+
+            history.push_back(line);
+            while(history.size() > max_history)
+            {
+                history.pop_front();
+            }
+        }
+
+        enum log_level { log_off = 0, log_error, log_warning, log_info, log_verbose };
+
+        struct log_channel
+        {
+            std::string name;
+            std::atomic<int> level{log_warning}; /* 'set log_<name>' may run while other threads log */
+            console* owner = nullptr;
+
+            bool enabled(int message_level) const
+            {
+                return message_level <= level.load(std::memory_order_relaxed);
+            }
+
+            void set_level(int new_level)
+            {
+                level.store(new_level, std::memory_order_relaxed);
+            }
+
+            template<typename F>
+            void log(int message_level, F format) /* format(std::ostream&), only called if enabled */
+            {
+                if(message_level > NOCLIP_LOG_MAX_LEVEL || !enabled(message_level)) return;
+
+                std::ostringstream message;
+                format(message);
+                write(message_level, message.str());
+            }
+
+            void write(int message_level, const std::string& message)
+            {
+                owner->write_log(*this, message_level, message);
+            }
+        };
+
+        /*  Channels live as long as the console; the returned reference stays
+            valid. Each channel gets a 'log_<name>' CVar holding its level
+            (0 silences it). Adding an existing channel returns it unchanged. */
+        log_channel& add_log_channel(const std::string& name, int level = log_warning)
+        {
+            auto l_iter = log_channels.find(name);
+            if(l_iter != log_channels.end()) return l_iter->second;
+
+            log_channel& channel = log_channels[name];
+            channel.name = name;
+            channel.set_level(level);
+            channel.owner = this;
+
+            std::string vid = "log_" + name;
+            erase_cvar_ref(vid);
+
+            cvar_setter_lambdas[vid] =
+                [this, vid, &channel](std::istream& is, std::ostream& os)
+                {
+                    int read = this->evaluate_argument<int>(is, os);
+
+                    if(is.fail())
+                    {
+                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << vid
+                        << "' is of type '" << typeid(int).name() << "'." << std::endl;
+
+                        is.clear();
+                    }
+                    else
+                    {
+                        channel.set_level(read);
+                    }
+                };
+
+            cvar_getter_slot(vid) =
+                [&channel](std::istream& is, std::ostream& os)
+                {
+                    os << channel.level.load(std::memory_order_relaxed) << std::endl;
+                };
+
+            apply_pending_value(vid);
+            return channel;
+        }
+
+        std::map<std::string, log_channel> log_channels;
+
+        /*  The last max_log_lines messages that passed their channel's level
+            are kept as '[channel] message'. log_sink, if set, also receives
+            each message as it is written (under the log lock, so it must not
+            log itself). Set both before jobs start logging. */
+        size_t max_log_lines = 256;
+        std::function<void(const log_channel& channel, int level, const std::string& message)> log_sink;
+
+        void log_lines(std::vector<std::string>& out, bool drain = false)
+        {
+            /*  Copies the kept messages into out, oldest first, and with drain
+                also removes them. Safe to call while other threads log. */
+            std::lock_guard<std::mutex> lock(log_mutex);
+
+            out.assign(log_history.begin(), log_history.end());
+            if(drain)
+            {
+                log_history.clear();
+            }
+        }
+
+        void write_log(const log_channel& channel, int level, const std::string& message)
+        {
+            std::lock_guard<std::mutex> lock(log_mutex);
+
+            log_history.push_back("[" + channel.name + "] " + message);
+            while(log_history.size() > max_log_lines)
+            {
+                log_history.pop_front();
+            }
+
+            if(log_sink)
+            {
+                log_sink(channel, level, message);
+            }
+        }
+
+        void pump(command_channel& channel)
+        {
+            /*  Executes the commands waiting in a command_channel and sends the
+                output of each back as its response. Call it from the same
+                per-tick pump step as pump(std::ostream&). Stops early while the
+                response ring is too full to take another response. */
+            while(channel.responses.free_space() >= command_channel::max_response + sizeof(uint32_t)
+                && channel.requests.pop(channel_request))
+            {
+                channel_response.str("");
+                execute_batch(channel_request, channel_response);
+
+                const std::string& text = channel_response.str();
+                channel.responses.push(text.data(), (uint32_t)std::min<size_t>(text.size(), command_channel::max_response));
+            }
+        }
+
+    private:
+        std::string channel_request;
+        std::ostringstream channel_response;
+
+        /*  A few of the most frequently executed commands are cached in front
+            of cmd_table, keyed by the hash of their id. The hashes sit in
+            their own array so the scan compiles to a handful of compares.
+            Use counts are halved periodically so the cache adapts when the
+            command mix changes. Entries are cleared by unbind_cmd; rebinding
+            an id keeps its table node, so cached iterators stay valid. That's
+            why cmd_table is private: every change goes through cmd_slot,
+            bind_many or unbind_cmd. */
+        function_table_t cmd_table;
+        static const size_t dispatch_cache_size = 8;
+        size_t dispatch_cache_hashes[dispatch_cache_size] = {};
+        function_table_t::iterator dispatch_cache_iters[dispatch_cache_size];
+        unsigned dispatch_cache_uses[dispatch_cache_size] = {};
+        unsigned dispatch_cache_lookups = 0;
+
+        function_table_t::iterator find_cmd(const std::string& cmd_id)
+        {
+            size_t hash = std::hash<std::string>()(cmd_id);
+
+            if(++dispatch_cache_lookups % 1024 == 0)
+            {
+                for (auto& uses : dispatch_cache_uses)
+                {
+                    uses = (uses + 1) / 2;
+                }
+            }
+
+            for (size_t i = 0; i < dispatch_cache_size; ++i)
+            {
+                if(dispatch_cache_hashes[i] == hash && dispatch_cache_uses[i]
+                    && dispatch_cache_iters[i]->first == cmd_id)
+                {
+                    ++dispatch_cache_uses[i];
+                    ++dispatch_cache_hits;
+                    return dispatch_cache_iters[i];
+                }
+            }
+
+            ++dispatch_cache_misses;
+            auto cmd_iter = cmd_table.find(cmd_id);
+            if(cmd_iter != cmd_table.end())
+            {
+                size_t victim = 0;
+                for (size_t i = 1; i < dispatch_cache_size; ++i)
+                {
+                    if(dispatch_cache_uses[i] < dispatch_cache_uses[victim]) victim = i;
+                }
+                dispatch_cache_hashes[victim] = hash;
+                dispatch_cache_iters[victim] = cmd_iter;
+                dispatch_cache_uses[victim] = 1;
+            }
+            return cmd_iter;
+        }
+
+        size_t flag_count = 0;
+
+        static bool glob_match(const char* pattern, const char* str)
+        {
+            /* '*' matches any run of characters and '?' any single character. */
+            const char* star = nullptr;
+            const char* resume = nullptr;
+            while(*str)
+            {
+                if(*pattern == '?' || *pattern == *str)
+                {
+                    ++pattern;
+                    ++str;
+                }
+                else if(*pattern == '*')
+                {
+                    star = pattern++;
+                    resume = str;
+                }
+                else if(star)
+                {
+                    pattern = star + 1;
+                    str = ++resume;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            while(*pattern == '*') ++pattern;
+            return *pattern == '\0';
+        }
+
+        void apply_pending_value(const std::string& vid)
+        {
+            if(pending_values.empty()) return;
+
+            auto p_iter = pending_values.find(vid);
+            if(p_iter == pending_values.end()) return;
+
+            std::istringstream value(p_iter->second);
+            pending_values.erase(p_iter);
+
+            std::ostringstream discard;
+            cvar_setter_lambdas[vid](value, discard);
+        }
+
+        template<typename Table>
+        generator_t list_ids(const Table& table, const char* empty_text, const char* header, bool skip_builtins)
+        {
+            /*  Lists list_chunk_lines ids per chunk. Each chunk resumes after
+                the last id listed rather than holding an iterator, so binding
+                or unbinding between chunks can't invalidate the listing. */
+            bool started = false;
+            std::string last;
+            return
+                [this, &table, empty_text, header, skip_builtins, started, last](std::ostream& os) mutable
+                {
+                    auto it = table.begin();
+                    if(!started)
+                    {
+                        started = true;
+                        if(table.empty())
+                        {
+                            os << empty_text << std::endl;
+                            return false;
+                        }
+                        os << header << std::endl;
+                    }
+                    else
+                    {
+                        it = table.upper_bound(last);
+                    }
+
+                    size_t chunk_lines = std::max<size_t>(1, this->list_chunk_lines);
+                    for (size_t lines = 0; it != table.end() && lines < chunk_lines; ++it)
+                    {
+                        if(skip_builtins && this->builtin_ids.count(it->first)) continue;
+
+                        os << "   " << it->first << std::endl;
+                        last = it->first;
+                        ++lines;
+                    }
+
+                    if(it == table.end()) return false;
+                    last = std::prev(it)->first;
+                    return true;
+                };
+        }
+
+        template<typename Table>
+        static void complete_from(const Table& table, const std::string& prefix, std::vector<const std::string*>& out)
+        {
+            for (auto it = table.lower_bound(prefix);
+                it != table.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+            {
+                out.push_back(&it->first);
+            }
+        }
+
+        std::set<std::string> builtin_ids;
+        name_pool cmd_names;
+        name_pool cvar_names;
+
+        console_function_t& cmd_slot(const std::string& cid)
+        {
+            /*  A command bound over a builtin (e.g. the game's own 'find')
+                is the game's now, so listCmds shows it. A command rebound over
+                a generator loses the generator, so open runs the new one. */
+            auto inserted = cmd_table.insert(std::make_pair(cid, console_function_t()));
+            if(inserted.second) cmd_names.add(cid);
+            builtin_ids.erase(cid);
+            generator_table.erase(cid);
+            replace_math_op(cid);
+            return inserted.first->second;
+        }
+
+        console_function_t& cvar_getter_slot(const std::string& vid)
+        {
+            auto inserted = cvar_getter_lambdas.insert(std::make_pair(vid, console_function_t()));
+            if(inserted.second) cvar_names.add(vid);
+            return inserted.first->second;
+        }
+        std::string help_path;
+        std::unordered_multimap<size_t, std::streamoff> help_index;
+        std::vector<const std::string*> dirty_cvars;
+        std::string cmd_id_scratch;
+        std::string cvar_id_scratch;
+        size_t notifications_held = 0;
+
+        /*  Streams over buffers the console owns, so nested expressions can
+            run a command and read its result back without building a
+            stringstream (and copying its string) every time. */
+        struct string_sink : std::streambuf
+        {
+            std::string* target = nullptr;
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if(!traits_type::eq_int_type(c, traits_type::eof())) target->push_back((char)c);
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char* s, std::streamsize n) override
+            {
+                target->append(s, (size_t)n);
+                return n;
+            }
+        };
+
+        struct char_source : std::streambuf
+        {
+            void reset(const std::string& text)
+            {
+                char* begin = const_cast<char*>(text.data());
+                setg(begin, begin, begin + text.size());
+            }
+        };
+
+        /*  Scratch owned by one level of expression nesting: the text and
+            output of the nested command evaluated at this level, and argument
+            strings for the string builtins running at it. They keep their
+            capacity, so once warmed up chained string expressions such as
+            (concat (upper a) (substr b 0 4)) make no allocations. */
+        struct expression_frame
+        {
+            expression_frame() : in(&source), out(&sink)
+            {
+                sink.target = &result;
+            }
+
+            std::string text;
+            std::string result;
+            std::string args[2];
+            char_source source;
+            string_sink sink;
+            std::istream in;
+            std::ostream out;
+        };
+        std::vector<std::unique_ptr<expression_frame>> expression_frames;
+        size_t expression_depth = 0;
+
+        expression_frame& current_expression_frame()
+        {
+            while(expression_frames.size() <= expression_depth)
+            {
+                expression_frames.emplace_back(new expression_frame());
+            }
+            return *expression_frames[expression_depth];
+        }
+
+        std::string& argument_scratch(size_t slot)
+        {
+            /*  For builtins: an argument string that lives until the builtin
+                returns. Nested expressions in its arguments use deeper frames. */
+            std::string& arg = current_expression_frame().args[slot];
+            arg.clear();
+            return arg;
+        }
+
+        struct preset_patch
+        {
+            cvar_id_t id; // nullptr once the CVar is unbound
+            const std::type_info* type;
+            size_t offset;
+            size_t size;
+            std::string line; // the 'set' line, run instead when the patch can't be used
+        };
+
+        struct preset
+        {
+            std::vector<preset_patch> patches;
+            std::vector<unsigned char> bytes;
+            std::string script; // lines that couldn't be compiled
+        };
+        std::map<std::string, preset> presets;
+
+        static bool patch_matches(const preset& p, const preset_patch& patch)
+        {
+            return patch.id && *patch.type == *patch.id->second.type
+                && std::memcmp(patch.id->second.mem, &p.bytes[patch.offset], patch.size) == 0;
+        }
+
+        typedef std::chrono::steady_clock policy_clock;
+        struct cvar_policy
+        {
+            set_policy policy = set_immediate;
+            policy_clock::duration window = policy_clock::duration::zero();
+            bool held = false;
+            policy_clock::time_point deadline;
+            std::string value; // debounce: latest value text
+        };
+        std::map<std::string, cvar_policy> cvar_policies;
+
+        bool hold_debounced_set(const std::string& vid, std::istream& is)
+        {
+            auto p_iter = cvar_policies.find(vid);
+            if(p_iter == cvar_policies.end() || p_iter->second.policy != set_debounce) return false;
+
+            cvar_policy& p = p_iter->second;
+            std::getline(is >> std::ws, p.value);
+            if(!p.held)
+            {
+                p.held = true;
+                p.deadline = policy_clock::now() + p.window;
+            }
+            return true;
+        }
+
+        void hold_coalesced_changes()
+        {
+            /*  Takes CVars with the coalesce policy out of the dirty list; they
+                are reported by flush_held_sets when their window ends. */
+            size_t kept = 0;
+            for (size_t i = 0; i < dirty_cvars.size(); ++i)
+            {
+                auto p_iter = cvar_policies.find(*dirty_cvars[i]);
+                if(p_iter == cvar_policies.end() || p_iter->second.policy != set_coalesce)
+                {
+                    dirty_cvars[kept++] = dirty_cvars[i];
+                    continue;
+                }
+
+                cvar_policy& p = p_iter->second;
+                if(!p.held)
+                {
+                    p.held = true;
+                    p.deadline = policy_clock::now() + p.window;
+                }
+            }
+            dirty_cvars.resize(kept);
+        }
+        std::mutex log_mutex;
+        std::deque<std::string> log_history;
+        std::vector<std::pair<cvar_id_t, void(*)(void*)>> dirty_latches;
+
+        template<typename T>
+        static void publish_latched(void* vmem)
+        {
+            latched<T>* l = static_cast<latched<T>*>(vmem);
+            l->value = l->pending;
+            l->dirty = false;
+        }
+
+        template<typename T>
+        cvar_id_t add_cvar_ref(const std::string& vid, T* vmem)
+        {
+            auto v_ref_iter = cvar_refs.insert(std::make_pair(vid, cvar_ref())).first;
+            forget_latch(&*v_ref_iter);
+            fill_cvar_ref(v_ref_iter->second, vmem);
+            return &*v_ref_iter;
+        }
+
+        void forget_latch(cvar_id_t id)
+        {
+            /*  A CVar rebound without unbind_cvar keeps its cvar_refs entry.
+                A latch still pending for the old binding must not be
+                published into the new variable, which may have another type. */
+            for (size_t i = 0; i < dirty_latches.size(); ++i)
+            {
+                if(dirty_latches[i].first == id)
+                {
+                    dirty_latches.erase(dirty_latches.begin() + i);
+                    return;
+                }
+            }
+        }
+
+        void remove_flag_from_groups(flag_id_t id)
+        {
+            for (auto& group : flag_groups)
+            {
+                if(id / 64 < group.second.size())
+                {
+                    group.second[id / 64] &= ~(uint64_t(1) << (id % 64));
+                }
+            }
+        }
+
+        void erase_cvar_ref(const std::string& vid)
+        {
+            /*  Drops the typed address of a CVar along with everything that
+                refers to it, so read_many, write_many and presets can't reach a
+                variable that is no longer bound. The pending latch is dropped;
+                preset patches fall back to their 'set' line. Called by
+                unbind_cvar and by the bind overloads that don't keep a typed
+                address. */
+            auto v_ref_iter = cvar_refs.find(vid);
+            if(v_ref_iter == cvar_refs.end()) return;
+
+            forget_latch(&*v_ref_iter);
+
+            for (auto& it : presets)
+            {
+                for (auto& patch : it.second.patches)
+                {
+                    if(patch.id == &*v_ref_iter) patch.id = nullptr;
+                }
+            }
+
+            cvar_refs.erase(v_ref_iter);
+        }
+
+        template<typename T>
+        static void fill_cvar_ref(cvar_ref& ref, T* vmem)
+        {
+            ref.mem = vmem;
+            ref.type = &typeid(T);
+            fill_cvar_patch_info<T>(ref, std::is_arithmetic<T>());
         }
 
-        typedef std::map<std::string, console_function_t> function_table_t;
-        function_table_t cmd_table;
-        function_table_t cvar_setter_lambdas;
-        function_table_t cvar_getter_lambdas;
+        template<typename T>
+        static void fill_cvar_patch_info(cvar_ref& ref, std::true_type)
+        {
+            ref.size = sizeof(T);
+            ref.parse = &console::parse_cvar_value<T>;
+        }
 
         template<typename T>
-        void bind_cvar(const std::string& vid, T* vmem)
+        static void fill_cvar_patch_info(cvar_ref& ref, std::false_type)
         {
-            cvar_setter_lambdas[vid] =
-                [this, vid, vmem](std::istream& is, std::ostream& os)
+            ref.size = 0;
+            ref.parse = nullptr;
+        }
+
+        template<typename T>
+        static bool parse_cvar_value(console& c, std::istream& is, std::ostream& os, void* out)
+        {
+            c.evaluate_argument(is, os, *static_cast<T*>(out));
+            return !is.fail();
+        }
+
+        template<typename T>
+        console_function_t make_cvar_setter(cvar_id_t id, T* vmem)
+        {
+            return
+                [this, id, vmem](std::istream& is, std::ostream& os)
                 {
                     T read = this->evaluate_argument<T>(is, os);
 
                     if(is.fail())
                     {
                         const char* vt = typeid(T).name();
-                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << vid 
+                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << id->first 
                         << "' is of type '" << vt << "'." << std::endl;
 
                         is.clear();
@@ -145,29 +2202,72 @@ namespace noclip
                     else
                     {
                         *vmem = read;
+                        this->mark_changed(id);
+                        this->notify_changed();
+                    }
+                };
+        }
+
+        console_function_t make_cvar_setter(cvar_id_t id, std::string* vmem)
+        {
+            /*  String CVars decode into a scratch buffer owned by the setter and
+                then swap it with the CVar. The CVar's previous buffer becomes the
+                scratch for the next set, so repeated sets recycle the same two
+                buffers instead of reallocating through the global allocator. */
+            std::string scratch;
+            return
+                [this, id, vmem, scratch](std::istream& is, std::ostream& os) mutable
+                {
+                    this->evaluate_argument(is, os, scratch);
+
+                    if(is.fail())
+                    {
+                        os << "NOCLIP::CONSOLE ERROR: Type mismatch. CVar '" << id->first
+                        << "' is of type '" << typeid(std::string).name() << "'." << std::endl;
+
+                        is.clear();
+                    }
+                    else
+                    {
+                        vmem->swap(scratch);
+                        this->mark_changed(id);
+                        this->notify_changed();
                     }
                 };
+        }
 
-            cvar_getter_lambdas[vid] =
+        template<typename T>
+        static console_function_t make_cvar_getter(T* vmem)
+        {
+            return
                 [vmem](std::istream& is, std::ostream& os)
                 {
                     os << *vmem << std::endl;
                 };
         }
 
+        template<typename T>
+        static void make_cvar_lambdas(console& c, cvar_ref_table_t::value_type& ref, void* vmem, console_function_t& setter, console_function_t& getter)
+        {
+            fill_cvar_ref(ref.second, static_cast<T*>(vmem));
+            setter = c.make_cvar_setter(&ref, static_cast<T*>(vmem));
+            getter = make_cvar_getter(static_cast<T*>(vmem));
+        }
+
         template<typename ... Args>
-        void bind_cmd(const std::string& cid, void(*f_ptr)(Args ...))
+        console_function_t make_cmd(void(*f_ptr)(Args ...))
         {
-            cmd_table[cid] = 
-                [this, f_ptr](std::istream& is, std::ostream& os)
+            std::function<void(Args ...)> std_fp(f_ptr);
+
+            return
+                [this, std_fp](std::istream& is, std::ostream& os)
                 {
-                    auto std_fp = std::function<void(Args ...)>(f_ptr);
                     this->materialize_and_execute<Args ...>(is, os, std_fp);
                 };
         }
 
-        template<typename O, typename ... Args> /* Use :: syntax e.g. bind_cmd("name", &A::f, &a) */
-        void bind_cmd(const std::string& cid, void(O::*f_ptr)(Args ...), O* omem)
+        template<typename O, typename ... Args>
+        console_function_t make_cmd(void(O::*f_ptr)(Args ...), O* omem)
         {
             std::function<void(Args...)> std_fp =
                 [f_ptr, omem](Args ... args)
@@ -175,88 +2275,173 @@ namespace noclip
                     (omem->*f_ptr)(args...); // could use std::mem_fn instead
                 };
 
-            cmd_table[cid] =
+            return
                 [this, std_fp](std::istream &is, std::ostream &os)
                 {
                     this->materialize_and_execute<Args...>(is, os, std_fp);
                 };
         }
 
-        void bind_cmd(const std::string& cid, console_function_t iofunc)
+        template<typename Table>
+        static typename Table::iterator insert_hinted(Table& table, typename Table::iterator hint,
+            const std::string& key, typename Table::mapped_type&& value)
         {
-            cmd_table[cid] = iofunc;
+            /*  Inserts (or replaces) key right before hint and returns the
+                position after it, the hint for the next key in ascending order. */
+            auto it = table.emplace_hint(hint, key, typename Table::mapped_type());
+            it->second = std::move(value);
+            return std::next(it);
         }
 
-        void unbind_cvar(const std::string& vid)
+        void mark_changed(cvar_id_t id)
         {
-            auto v_set_iter = cvar_setter_lambdas.find(vid);
-            if(v_set_iter != cvar_setter_lambdas.end())
+            dirty_cvars.push_back(&id->first);
+        }
+
+        void notify_changed()
+        {
+            /*  Reports every CVar marked since the last notification. The dirty
+                list is swapped out first so the callback may itself set CVars. */
+            if(dirty_cvars.empty() || notifications_held) return;
+            if(!cvar_policies.empty()) hold_coalesced_changes();
+            if(dirty_cvars.empty()) return;
+
+            std::vector<const std::string*> changed;
+            changed.swap(dirty_cvars);
+            if(on_cvars_changed)
             {
-                cvar_setter_lambdas.erase(v_set_iter);
+                on_cvars_changed(changed);
             }
 
-            auto v_get_iter = cvar_getter_lambdas.find(vid);
-            if(v_get_iter != cvar_getter_lambdas.end())
+            if(dirty_cvars.empty())
             {
-                cvar_getter_lambdas.erase(v_get_iter);
+                changed.clear();
+                dirty_cvars.swap(changed); // keep the capacity for next time
             }
         }
 
-        void unbind_cmd(const std::string& cid)
+        size_t read_cvar(const cvar_id_t* ids) const
         {
-            auto cmd_iter = cmd_table.find(cid);
-            if(cmd_iter != cmd_table.end())
+            /* base case */
+            return 0;
+        }
+
+        template<typename T, typename ... Ts>
+        size_t read_cvar(const cvar_id_t* ids, T& first, Ts&... rest) const
+        {
+            size_t read = 0;
+            if(*ids && *(*ids)->second.type == typeid(T))
             {
-                cmd_table.erase(cmd_iter);
+                first = *static_cast<const T*>((*ids)->second.mem);
+                read = 1;
             }
+            return read + read_cvar(ids + 1, rest...);
         }
 
-        void execute(std::istream& input, std::ostream& output)
+        size_t write_cvar(const cvar_id_t* ids)
         {
-            std::string cmd_id;
-            input >> cmd_id;
+            /* base case */
+            return 0;
+        }
 
-            auto cmd_iter = cmd_table.find(cmd_id);
-            if(cmd_iter == cmd_table.end())
+        template<typename T, typename ... Ts>
+        size_t write_cvar(const cvar_id_t* ids, const T& first, const Ts&... rest)
+        {
+            size_t written = 0;
+            if(*ids && *(*ids)->second.type == typeid(T))
             {
-                output << "NOCLIP::CONSOLE ERROR: Input '" << cmd_id << "' isn't a command." << std::endl;
-                return;
+                *static_cast<T*>((*ids)->second.mem) = first;
+                mark_changed(*ids);
+                written = 1;
             }
+            return written + write_cvar(ids + 1, rest...);
+        }
 
-            (cmd_iter->second)(input, output);
+        static size_t bounded_distance(const uint64_t* peq, const std::string& id, const char* candidate, size_t n, size_t bound)
+        {
+            /*  Every character of candidate that never appears in id costs at
+                least one edit, which rejects most candidates cheaply. */
+            const size_t m = id.size();
+            if((n > m ? n - m : m - n) > bound) return bound + 1;
+
+            size_t absent = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                if(peq[(unsigned char)candidate[i]] == 0 && ++absent > bound) return bound + 1;
+            }
+            return edit_distance(peq, m, candidate, n, bound);
         }
 
-        void execute(const std::string& str, std::ostream& output)
+        static size_t edit_distance(const uint64_t* peq, size_t m, const char* text, size_t n, size_t bound)
         {
-            std::stringstream line_stream;
-            line_stream.str(str);
-            execute(line_stream, output);
+            /*  Levenshtein distance between the pattern encoded in peq (bit i of
+                peq[c] is set if pattern[i] == c) and text. Pv/Mv hold the
+                positive/negative vertical deltas of the current DP column.
+                Returns bound + 1 as soon as the remaining columns can't bring
+                the score back within bound. */
+            const uint64_t last = uint64_t(1) << (m - 1);
+            uint64_t pv = ~uint64_t(0);
+            uint64_t mv = 0;
+            size_t score = m;
+            size_t remaining = n;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                uint64_t eq = peq[(unsigned char)text[i]];
+                uint64_t xv = eq | mv;
+                uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                uint64_t ph = mv | ~(xh | pv);
+                uint64_t mh = pv & xh;
+
+                if(ph & last) ++score;
+                else if(mh & last) --score;
+
+                ph = (ph << 1) | 1;
+                mh = mh << 1;
+                pv = mh | ~(xv | ph);
+                mv = ph & xv;
+
+                --remaining;
+                if(score > bound + remaining) return bound + 1;
+            }
+            return score;
         }
 
-    private:
-        void read_arg(std::istream& is)
+        void output_suggestion(std::ostream& os, const std::string& id, const function_table_t& table) const
+        {
+            const std::string* suggestion = suggest(id, table);
+            if(suggestion)
+            {
+                os << " Did you mean '" << *suggestion << "'?";
+            }
+        }
+
+        std::mutex queue_mutex;
+        std::vector<std::string> command_queue;
+        std::vector<std::string> pumped_commands;
+
+        void read_arg(std::istream& is, std::ostream& os)
         {
             /* base case */
         }
 
         template<typename T, typename ... Ts>
-        void read_arg(std::istream& is, T& first, Ts &... rest)
+        void read_arg(std::istream& is, std::ostream& os, T& first, Ts &... rest)
         {
             /*  Variadic template that recursively iterates each function 
                 argument type. For each arg type, parse the argument and
                 set value of first. First is a reference to a parameter 
                 of read_args_and_execute. */
 
-            std::ostringstream discard;
-            first = evaluate_argument<T>(is, discard);
-            read_arg(is, rest ...);
+            evaluate_argument(is, os, first);
+            read_arg(is, os, rest ...);
         }
 
         template <typename ... Args>
-        void read_args_and_execute(std::istream& is, std::ostream& os, std::function<void(Args ...)> f_ptr, 
+        void read_args_and_execute(std::istream& is, std::ostream& os, const std::function<void(Args ...)>& f_ptr, 
             typename std::remove_const<typename std::remove_reference<Args>::type>::type ... temps)
         {
-            read_arg(is, temps...);
+            read_arg(is, os, temps...);
 
             if(is.fail())
             {
@@ -268,7 +2453,7 @@ namespace noclip
         }
 
         template<typename ... Args>
-        void materialize_and_execute(std::istream& is, std::ostream& os, std::function<void(Args ...)> f_ptr)
+        void materialize_and_execute(std::istream& is, std::ostream& os, const std::function<void(Args ...)>& f_ptr)
         {
             read_args_and_execute(is, os, f_ptr, 
                 (materialize<typename std::remove_const<typename std::remove_reference<Args>::type>::type>())...);
@@ -289,7 +2474,17 @@ namespace noclip
         template<typename T>
         T evaluate_argument(std::istream& is, std::ostream& os)
         {
-            /*  Evaluate argument expressions e.g. set x (+ 3 7) */
+            T read = T();
+            evaluate_argument(is, os, read);
+            return read;
+        }
+
+        template<typename T>
+        void evaluate_argument(std::istream& is, std::ostream& os, T& out)
+        {
+            /*  Evaluate argument expressions e.g. set x (+ 3 7)
+                The result is decoded directly into out, so callers that keep
+                a destination around (e.g. string CVars) reuse its storage. */
 
             while(isspace(is.peek()))
             {
@@ -299,37 +2494,276 @@ namespace noclip
             if(is.peek() == '(')
             {
                 is.ignore(); // '('
-                const int max_argument_size = 256;
-                char argument_buffer[max_argument_size];
-                is.get(argument_buffer, max_argument_size, ')');
-                is.ignore(); // ')'
+                expression_frame& frame = current_expression_frame();
+                std::string& text = frame.text;
+                text.clear();
+
+                /*  Builtin math ops are evaluated right here, without going
+                    through cmd_table or printing and re-parsing the result. */
+                while(isspace(is.peek()))
+                {
+                    is.ignore();
+                }
+                while(is.peek() != EOF && !isspace(is.peek()) && is.peek() != '(' && is.peek() != ')')
+                {
+                    text += (char)is.get();
+                }
 
-                std::ostringstream result;
-                execute(std::string(argument_buffer), result);
+                const math_op* op = find_math_op(text.c_str());
+                if(op && evaluate_math(is, os, *op, out, std::is_arithmetic<T>())) return;
 
-                T read;
-                std::istringstream(result.str()) >> read;
-                return read;
+                int depth = 1;
+                for (int c = is.get(); c != EOF; c = is.get())
+                {
+                    /* match nested parentheses e.g. set x (+ (- 3 2) 4) */
+                    if(c == '(') ++depth;
+                    else if(c == ')' && --depth == 0) break; // ')'
+                    text += (char)c;
+                }
+
+                /*  The command runs one level deeper, so its own nested
+                    arguments don't overwrite this frame. */
+                frame.result.clear();
+                frame.source.reset(text);
+                frame.in.clear();
+                ++expression_depth;
+                execute(frame.in, frame.out);
+                --expression_depth;
+
+                frame.source.reset(frame.result);
+                frame.in.clear();
+                read_value(frame.in, out);
             }
             else
             {
-                T read;
-                is >> read;
-                return read;
+                read_value(is, out);
+            }
+        }
+
+        template<typename T>
+        void read_value(std::istream& is, T& out)
+        {
+            is >> out;
+        }
+
+        void read_value(std::istream& is, float& out)
+        {
+            double read = 0.0;
+            read_value(is, read);
+            if(!is.fail()) out = (float)read;
+        }
+
+        void read_value(std::istream& is, double& out)
+        {
+            /*  The standard library's floating point extraction accumulates
+                digits in a heap-allocated string. Reading the number into a
+                fixed buffer and converting with strtod keeps dispatch of
+                commands with floating point arguments allocation free. Like
+                >>, only the longest decimal prefix is consumed and the rest
+                is left in the stream: '3.5f' reads 3.5, '0x10' reads 0, and
+                the ')' after the last argument of an inline math op stays. */
+            char token[64];
+            size_t length = 0;
+            bool digits = false, point = false, exponent = false;
+            while(isspace(is.peek()))
+            {
+                is.ignore();
+            }
+            for (int c = is.peek(); c != EOF && length < sizeof(token) - 1; c = is.peek())
+            {
+                char last = length ? token[length - 1] : '\0';
+                if(isdigit(c)) digits = true;
+                else if((c == '+' || c == '-') && (length == 0 || last == 'e' || last == 'E')) {}
+                else if(c == '.' && !point && !exponent) point = true;
+                else if((c == 'e' || c == 'E') && digits && !exponent) exponent = true;
+                else break;
+
+                token[length++] = (char)is.get();
+            }
+            token[length] = '\0';
+
+            /*  A dangling sign, point or exponent ('-', '1e') fails, as it
+                does for >>. */
+            char* end = nullptr;
+            double read = std::strtod(token, &end);
+            if(!digits || end != token + length)
+            {
+                is.setstate(std::ios::failbit);
+                return;
+            }
+            out = read;
+        }
+
+        struct math_op
+        {
+            const char* id;
+            size_t arity;
+            float (*f1)(float);
+            float (*f2)(float, float);
+            float (*f3)(float, float, float);
+        };
+
+        static const math_op* builtin_math_ops(size_t& count)
+        {
+            static const math_op ops[] =
+            {
+                { "+", 2, nullptr, [](float a, float b){ return a + b; }, nullptr },
+                { "-", 2, nullptr, [](float a, float b){ return a - b; }, nullptr },
+                { "*", 2, nullptr, [](float a, float b){ return a * b; }, nullptr },
+                { "/", 2, nullptr, [](float a, float b){ return a / b; }, nullptr },
+                { "abs", 1, [](float x){ return std::fabs(x); }, nullptr, nullptr },
+                { "sqrt", 1, [](float x){ return std::sqrt(x); }, nullptr, nullptr },
+                { "floor", 1, [](float x){ return std::floor(x); }, nullptr, nullptr },
+                { "ceil", 1, [](float x){ return std::ceil(x); }, nullptr, nullptr },
+                { "sin", 1, [](float x){ return std::sin(x); }, nullptr, nullptr },
+                { "cos", 1, [](float x){ return std::cos(x); }, nullptr, nullptr },
+                { "tan", 1, [](float x){ return std::tan(x); }, nullptr, nullptr },
+                { "min", 2, nullptr, [](float a, float b){ return std::min(a, b); }, nullptr },
+                { "max", 2, nullptr, [](float a, float b){ return std::max(a, b); }, nullptr },
+                { "pow", 2, nullptr, [](float a, float b){ return std::pow(a, b); }, nullptr },
+                { "clamp", 3, nullptr, nullptr, [](float x, float lo, float hi){ return std::min(std::max(x, lo), hi); } },
+                { "lerp", 3, nullptr, nullptr, [](float a, float b, float t){ return a + (b - a) * t; } },
+                { "smoothstep", 3, nullptr, nullptr,
+                    [](float edge0, float edge1, float x)
+                    {
+                        float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.f), 1.f);
+                        return t * t * (3.f - 2.f * t);
+                    } },
+            };
+            count = sizeof(ops) / sizeof(ops[0]);
+            return ops;
+        }
+
+        /*  Bit i is set once the command of builtin_math_ops()[i] has been
+            rebound or unbound, so expressions stop evaluating it inline. */
+        uint32_t math_ops_replaced = 0;
+
+        const math_op* find_math_op(const char* id) const
+        {
+            size_t count = 0;
+            const math_op* ops = builtin_math_ops(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if(std::strcmp(ops[i].id, id) == 0)
+                {
+                    return (math_ops_replaced & (uint32_t(1) << i)) ? nullptr : &ops[i];
+                }
+            }
+            return nullptr;
+        }
+
+        void replace_math_op(const std::string& cid)
+        {
+            size_t count = 0;
+            const math_op* ops = builtin_math_ops(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                if(cid == ops[i].id) math_ops_replaced |= uint32_t(1) << i;
+            }
+        }
+
+        template<typename T>
+        bool evaluate_math(std::istream& is, std::ostream& os, const math_op& op, T& out, std::true_type)
+        {
+            /*  Called after '(' and the op id have been read. Arguments may be
+                nested expressions themselves. */
+            float a = evaluate_argument<float>(is, os);
+            float b = op.arity > 1 ? evaluate_argument<float>(is, os) : 0.f;
+            float c = op.arity > 2 ? evaluate_argument<float>(is, os) : 0.f;
+            float result = op.arity == 1 ? op.f1(a) : op.arity == 2 ? op.f2(a, b) : op.f3(a, b, c);
+
+            int depth = 1;
+            for (int ch = is.get(); ch != EOF; ch = is.get())
+            {
+                if(ch == '(') ++depth;
+                else if(ch == ')' && --depth == 0) break;
+            }
+
+            /*  Converting a float that doesn't fit (or is nan) to an integer
+                is undefined, so e.g. (* 1e10 1) into an int fails instead. The
+                bounds are widened to double so they're exact. */
+            if(is.fail() || (std::is_integral<T>::value
+                && !(result > (double)std::numeric_limits<T>::lowest() - 1.0
+                    && result < (double)std::numeric_limits<T>::max() + 1.0)))
+            {
+                is.setstate(std::ios::failbit);
+                return true;
             }
+            out = (T)result;
+            return true;
+        }
+
+        template<typename T>
+        bool evaluate_math(std::istream& is, std::ostream& os, const math_op& op, T& out, std::false_type)
+        {
+            /*  Non-numeric destinations (e.g. string CVars) take the printed
+                result through the command path. */
+            return false;
+        }
+
+        void bind_builtin_math(const std::string& id, float(*f)(float))
+        {
+            cmd_table[id] =
+                [this, f](std::istream& is, std::ostream& os)
+                {
+                    float x = this->evaluate_argument<float>(is, os);
+                    os << f(x) << std::endl;
+                };
+        }
+
+        void bind_builtin_math(const std::string& id, float(*f)(float, float))
+        {
+            cmd_table[id] =
+                [this, f](std::istream& is, std::ostream& os)
+                {
+                    float a = this->evaluate_argument<float>(is, os);
+                    float b = this->evaluate_argument<float>(is, os);
+                    os << f(a, b) << std::endl;
+                };
+        }
+
+        void bind_builtin_math(const std::string& id, float(*f)(float, float, float))
+        {
+            cmd_table[id] =
+                [this, f](std::istream& is, std::ostream& os)
+                {
+                    float a = this->evaluate_argument<float>(is, os);
+                    float b = this->evaluate_argument<float>(is, os);
+                    float c = this->evaluate_argument<float>(is, os);
+                    os << f(a, b, c) << std::endl;
+                };
         }
 
         void bind_builtin_commands()
         {
+            completion_providers["set"] = completion_providers["get"] =
+                [this](size_t arg_index, const std::string& prefix, std::vector<const std::string*>& out)
+                {
+                    if(arg_index == 0) complete_from(cvar_getter_lambdas, prefix, out);
+                };
+
             cmd_table["set"] = 
                 [this](std::istream& is, std::ostream& os)
                 {
-                    std::string vid;
+                    std::string& vid = cvar_id_scratch;
                     is >> vid;
                     auto v_iter = cvar_setter_lambdas.find(vid);
-                    if(v_iter == cvar_setter_lambdas.end())
+                    if(v_iter == cvar_setter_lambdas.end() && keep_pending_values)
+                    {
+                        std::string value;
+                        std::getline(is >> std::ws, value);
+                        pending_values[vid] = value;
+                        return;
+                    }
+                    else if(v_iter == cvar_setter_lambdas.end())
+                    {
+                        os << "NOCLIP::CONSOLE ERROR: There is no bound variable with id '" << vid << "'.";
+                        output_suggestion(os, vid, cvar_getter_lambdas);
+                        os << std::endl;
+                        return;
+                    }
+                    else if(!cvar_policies.empty() && hold_debounced_set(vid, is))
                     {
-                        os << "NOCLIP::CONSOLE ERROR: There is no bound variable with id '" << vid << "'." << std::endl;
                         return;
                     }
                     else
@@ -341,12 +2775,14 @@ namespace noclip
             cmd_table["get"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    std::string vid;
+                    std::string& vid = cvar_id_scratch;
                     is >> vid;
                     auto v_iter = cvar_getter_lambdas.find(vid);
                     if(v_iter == cvar_getter_lambdas.end())
                     {
-                        os << "NOCLIP::CONSOLE ERROR: There is no bound variable with id '" << vid << "'." << std::endl;
+                        os << "NOCLIP::CONSOLE ERROR: There is no bound variable with id '" << vid << "'.";
+                        output_suggestion(os, vid, cvar_getter_lambdas);
+                        os << std::endl;
                         return;
                     }
                     else
@@ -356,8 +2792,24 @@ namespace noclip
                 };
 
             cmd_table["help"] =
-                [](std::istream& is, std::ostream& os)
+                [this](std::istream& is, std::ostream& os)
                 {
+                    while(is.peek() == ' ' || is.peek() == '\t')
+                    {
+                        is.ignore();
+                    }
+
+                    if(is.peek() != '\n' && is.peek() != EOF)
+                    {
+                        std::string id;
+                        is >> id;
+                        if(!this->print_help(id, os))
+                        {
+                            os << "NOCLIP::CONSOLE ERROR: There is no help for '" << id << "'." << std::endl;
+                        }
+                        return;
+                    }
+
                     os << "-- noclip::console help --" << std::endl;
                     os << "Set and get bound variables with" << std::endl;
                     os << "set <cvar id> <value>" << std::endl;
@@ -368,11 +2820,26 @@ namespace noclip
                     os << std::endl;
                     os << "Get help" << std::endl;
                     os << "help : outputs noclip::console help" << std::endl;
+                    os << "help <id> : outputs help for a command or variable" << std::endl;
                     os << "listCVars : outputs info about every bound console variable" << std::endl;
                     os << "listCmds : outputs info about every bound console command" << std::endl;
                     os << std::endl;
+                    os << "Set, clear or toggle many flags at once" << std::endl;
+                    os << "flags <set|clear|toggle> <group or glob e.g. r_debug_*>" << std::endl;
+                    os << std::endl;
+                    os << "Apply or list presets (* marks the active one)" << std::endl;
+                    os << "preset <name>, preset" << std::endl;
+                    os << std::endl;
                     os << "Perform arithematic and modulo operations" << std::endl;
                     os << "(+, -, *, /, %) <lhs> <rhs>" << std::endl;
+                    os << "(abs, sqrt, floor, ceil, sin, cos, tan) <x>" << std::endl;
+                    os << "(min, max, pow) <a> <b>" << std::endl;
+                    os << "clamp <x> <lo> <hi>, lerp <a> <b> <t>, smoothstep <edge 0> <edge 1> <x>" << std::endl;
+                    os << std::endl;
+                    os << "Manipulate strings" << std::endl;
+                    os << "concat <a> <b>, substr <str> <pos> <len>, upper <str>, lower <str>" << std::endl;
+                    os << "find <str> <substr> : index of substr in str, or -1" << std::endl;
+                    os << "format <fmt> <arg 0> ... <arg n> : replaces each {} in fmt with the next arg" << std::endl;
                     os << std::endl;
                     os << "You can pass expressions as arguments" << std::endl;
                     os << "+ (- 3 2) (* 4 5)" << std::endl;
@@ -388,85 +2855,211 @@ namespace noclip
                     */
                 };
 
-            cmd_table["listCVars"] =
+            cmd_table["preset"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    if(cvar_getter_lambdas.size() == 0)
+                    while(is.peek() == ' ' || is.peek() == '\t')
+                    {
+                        is.ignore();
+                    }
+
+                    if(is.peek() != '\n' && is.peek() != EOF)
                     {
-                        os << "There are no bound console variables..." << std::endl;
+                        std::string name;
+                        is >> name;
+                        if(!this->apply_preset(name, os))
+                        {
+                            os << "NOCLIP::CONSOLE ERROR: There is no preset '" << name << "'." << std::endl;
+                        }
                         return;
                     }
 
-                    os << "Bound console variable names:" << std::endl;
-                    for (auto& it: cvar_getter_lambdas)
+                    const std::string* active = this->active_preset();
+                    for (auto& it : presets)
                     {
-                        os << "   " << it.first << std::endl;
+                        os << (&it.first == active ? " * " : "   ") << it.first << std::endl;
                     }
                 };
 
-            cmd_table["listCmds"] =
+            cmd_table["flags"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    if(cmd_table.size() == 0)
+                    std::string op, pattern;
+                    is >> op >> pattern;
+
+                    flag_op fop;
+                    if(op == "set") fop = flag_set;
+                    else if(op == "clear") fop = flag_clear;
+                    else if(op == "toggle") fop = flag_toggle;
+                    else
                     {
-                        os << "There are no bound console commands..." << std::endl;
+                        os << "NOCLIP::CONSOLE ERROR: Usage: flags <set|clear|toggle> <group or glob>" << std::endl;
                         return;
                     }
 
-                    os << "Bound console command names:" << std::endl;
-                    for (auto& it : cmd_table)
+                    if(this->set_flags(pattern, fop) == 0)
                     {
-                        if (it.first == "+" || it.first == "-" || it.first == "*" || it.first == "/" 
-                            || it.first == "%" || it.first == "set" || it.first == "get" || it.first == "help" 
-                            || it.first == "listCmds" || it.first == "listCVars") continue;
-
-                        os << "   " << it.first << std::endl;
+                        os << "NOCLIP::CONSOLE ERROR: There are no flags in group or matching '" << pattern << "'." << std::endl;
                     }
                 };
 
-            cmd_table["+"] =
+            bind_generator("listCVars",
                 [this](std::istream& is, std::ostream& os)
                 {
-                    float a = this->evaluate_argument<float>(is, os);
-                    float b = this->evaluate_argument<float>(is, os);
-                    os << a + b << std::endl;
+                    return this->list_ids(cvar_getter_lambdas,
+                        "There are no bound console variables...", "Bound console variable names:", false);
+                });
+
+            bind_generator("listCmds",
+                [this](std::istream& is, std::ostream& os)
+                {
+                    return this->list_ids(cmd_table,
+                        "There are no bound console commands...", "Bound console command names:", true);
+                });
+
+            cmd_table["%"] =
+                [this](std::istream& is, std::ostream& os)
+                {
+                    int a = this->evaluate_argument<int>(is, os);
+                    int b = this->evaluate_argument<int>(is, os);
+                    os << a % b << std::endl;
                 };
 
-            cmd_table["-"] =
+            size_t math_op_count = 0;
+            const math_op* ops = builtin_math_ops(math_op_count);
+            for (size_t i = 0; i < math_op_count; ++i)
+            {
+                if(ops[i].arity == 1) bind_builtin_math(ops[i].id, ops[i].f1);
+                else if(ops[i].arity == 2) bind_builtin_math(ops[i].id, ops[i].f2);
+                else bind_builtin_math(ops[i].id, ops[i].f3);
+            }
+
+            /*  String builtins stream their result straight into the output
+                instead of building an intermediate result string, and read
+                their arguments into the expression frame's scratch strings. */
+            cmd_table["concat"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    float a = this->evaluate_argument<float>(is, os);
-                    float b = this->evaluate_argument<float>(is, os);
-                    os << a - b << std::endl;
+                    std::string& a = this->argument_scratch(0);
+                    std::string& b = this->argument_scratch(1);
+                    this->evaluate_argument(is, os, a);
+                    this->evaluate_argument(is, os, b);
+                    os << a << b << std::endl;
                 };
 
-            cmd_table["*"] =
+            cmd_table["substr"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    float a = this->evaluate_argument<float>(is, os);
-                    float b = this->evaluate_argument<float>(is, os);
-                    os << a * b << std::endl;
+                    std::string& str = this->argument_scratch(0);
+                    this->evaluate_argument(is, os, str);
+                    size_t pos = this->evaluate_argument<size_t>(is, os);
+                    size_t len = this->evaluate_argument<size_t>(is, os);
+                    if(pos < str.size())
+                    {
+                        os.write(str.data() + pos, (std::streamsize)std::min(len, str.size() - pos));
+                    }
+                    os << std::endl;
                 };
 
-            cmd_table["/"] =
+            cmd_table["upper"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    float a = this->evaluate_argument<float>(is, os);
-                    float b = this->evaluate_argument<float>(is, os);
-                    os << a / b << std::endl;
+                    std::string& str = this->argument_scratch(0);
+                    this->evaluate_argument(is, os, str);
+                    for (char c : str)
+                    {
+                        os.put((char)toupper((unsigned char)c));
+                    }
+                    os << std::endl;
                 };
 
-            cmd_table["%"] =
+            cmd_table["lower"] =
                 [this](std::istream& is, std::ostream& os)
                 {
-                    int a = this->evaluate_argument<int>(is, os);
-                    int b = this->evaluate_argument<int>(is, os);
-                    os << a % b << std::endl;
+                    std::string& str = this->argument_scratch(0);
+                    this->evaluate_argument(is, os, str);
+                    for (char c : str)
+                    {
+                        os.put((char)tolower((unsigned char)c));
+                    }
+                    os << std::endl;
+                };
+
+            cmd_table["find"] =
+                [this](std::istream& is, std::ostream& os)
+                {
+                    std::string& str = this->argument_scratch(0);
+                    std::string& sub = this->argument_scratch(1);
+                    this->evaluate_argument(is, os, str);
+                    this->evaluate_argument(is, os, sub);
+                    size_t at = str.find(sub);
+                    os << (at == std::string::npos ? -1 : (long long)at) << std::endl;
+                };
+
+            cmd_table["format"] =
+                [this](std::istream& is, std::ostream& os)
+                {
+                    std::string& fmt = this->argument_scratch(0);
+                    std::string& arg = this->argument_scratch(1);
+                    this->evaluate_argument(is, os, fmt);
+                    size_t from = 0;
+                    for (size_t at = fmt.find("{}"); at != std::string::npos; at = fmt.find("{}", from))
+                    {
+                        os.write(fmt.data() + from, (std::streamsize)(at - from));
+                        arg.clear();
+                        this->evaluate_argument(is, os, arg);
+                        os << arg;
+                        from = at + 2;
+                    }
+                    os.write(fmt.data() + from, (std::streamsize)(fmt.size() - from));
+                    os << std::endl;
                 };
         }
     };
 }
 
+/*  Debug check that nothing allocates inside a noclip::no_alloc_scope.
+    Define NOCLIP_CHECK_ALLOCATIONS in exactly one translation unit before
+    including this header; it replaces the global operator new and calls
+    NOCLIP_ON_ALLOC(size) for every allocation made inside a scope. The
+    default asserts; define NOCLIP_ON_ALLOC yourself to count or log.
+    operator delete is kept out of line: GCC would otherwise inline its
+    free() into code that got the pointer from a new expression and warn
+    about a mismatched deallocation (-Wmismatched-new-delete). */
+#ifdef NOCLIP_CHECK_ALLOCATIONS
+#include <cassert>
+#include <new>
+
+#ifndef NOCLIP_ON_ALLOC
+#define NOCLIP_ON_ALLOC(size) assert(!"noclip: allocation inside no_alloc_scope")
+#endif
+
+#if defined(__GNUC__)
+#define NOCLIP_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define NOCLIP_NOINLINE __declspec(noinline)
+#else
+#define NOCLIP_NOINLINE
+#endif
+
+void* operator new(std::size_t size)
+{
+    if(noclip::no_alloc_depth() > 0)
+    {
+        NOCLIP_ON_ALLOC(size);
+    }
+
+    void* p = std::malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+NOCLIP_NOINLINE void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+#endif //NOCLIP_CHECK_ALLOCATIONS
+
 
 /*
 ------------------------------------------------------------------------------